@@ -0,0 +1,183 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+namespace Thunder {
+
+    // The last <slots> calls, each with the moments it started, got hold of the interface, was
+    // done invoking and had released the interface again. Recording is lock-free: a call claims
+    // the next slot and fills it, older calls are simply overwritten. Every slot carries a
+    // sequence number, so a dump skips the slots that are being written while it reads them.
+    class CallTrace {
+    private:
+        struct Slot {
+            std::atomic<uint64_t> Sequence; // 0 is empty, odd is being written
+            std::atomic<uint8_t> Operation;
+            std::atomic<uint32_t> Thread;
+            std::atomic<uint64_t> Begin;
+            std::atomic<uint64_t> Acquired;
+            std::atomic<uint64_t> Invoked;
+            std::atomic<uint64_t> End;
+        };
+
+    public:
+        CallTrace() = delete;
+        CallTrace(const CallTrace&) = delete;
+        CallTrace& operator=(const CallTrace&) = delete;
+
+        // The number of slots is rounded up to a power of two.
+        CallTrace(const uint32_t slots)
+            : _mask(Capacity(slots) - 1)
+            , _slots(new Slot[_mask + 1])
+            , _head(0)
+            , _threads(0)
+        {
+            for (uint32_t index = 0; index <= _mask; index++) {
+                _slots[index].Sequence.store(0, std::memory_order_relaxed);
+            }
+        }
+        ~CallTrace() = default;
+
+    public:
+        void Add(const uint8_t operation, const uint64_t begin, const uint64_t acquired, const uint64_t invoked, const uint64_t end)
+        {
+            static thread_local uint32_t thread = 0;
+
+            if (thread == 0) {
+                thread = _threads.fetch_add(1, std::memory_order_relaxed) + 1;
+            }
+
+            uint64_t claimed = _head.fetch_add(1, std::memory_order_relaxed);
+            Slot& slot(_slots[claimed & _mask]);
+
+            slot.Sequence.store((claimed * 2) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            slot.Operation.store(operation, std::memory_order_relaxed);
+            slot.Thread.store(thread, std::memory_order_relaxed);
+            slot.Begin.store(begin, std::memory_order_relaxed);
+            slot.Acquired.store(acquired, std::memory_order_relaxed);
+            slot.Invoked.store(invoked, std::memory_order_relaxed);
+            slot.End.store(end, std::memory_order_relaxed);
+
+            slot.Sequence.store((claimed * 2) + 2, std::memory_order_release);
+        }
+        // Calls recorded since the start, including the ones that were overwritten.
+        uint64_t Recorded() const
+        {
+            return (_head.load(std::memory_order_relaxed));
+        }
+        // Writes the calls in the Chrome trace event format (chrome://tracing, Perfetto, speedscope):
+        // every call is an event named after its operation, with the acquire, invoke and release
+        // phases nested in it. Returns the number of calls written.
+        uint32_t Dump(const std::string& fileName, const char* const names[], const uint8_t count) const
+        {
+            FILE* output = fopen(fileName.c_str(), "w");
+            uint32_t written = 0;
+
+            if (output != nullptr) {
+                uint64_t origin = ~0ULL;
+
+                for (uint32_t index = 0; index <= _mask; index++) {
+                    Record record;
+                    if ((Read(_slots[index], record) == true) && (record.Begin < origin)) {
+                        origin = record.Begin;
+                    }
+                }
+
+                fprintf(output, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+                for (uint32_t index = 0; index <= _mask; index++) {
+                    Record record;
+
+                    if (Read(_slots[index], record) == true) {
+                        const char* name = (record.Operation < count ? names[record.Operation] : "call");
+
+                        Event(output, (written == 0), name, record.Thread, record.Begin - origin, record.End - record.Begin);
+                        Event(output, false, "acquire", record.Thread, record.Begin - origin, record.Acquired - record.Begin);
+                        Event(output, false, "invoke", record.Thread, record.Acquired - origin, record.Invoked - record.Acquired);
+                        Event(output, false, "release", record.Thread, record.Invoked - origin, record.End - record.Invoked);
+                        written++;
+                    }
+                }
+
+                fprintf(output, "]}\n");
+                fclose(output);
+            }
+
+            return (written);
+        }
+
+    private:
+        struct Record {
+            uint8_t Operation;
+            uint32_t Thread;
+            uint64_t Begin;
+            uint64_t Acquired;
+            uint64_t Invoked;
+            uint64_t End;
+        };
+
+        static uint32_t Capacity(const uint32_t slots)
+        {
+            uint32_t result = 1;
+            while ((result < slots) && (result < 0x80000000)) {
+                result <<= 1;
+            }
+            return (result);
+        }
+        static bool Read(const Slot& slot, Record& record)
+        {
+            uint64_t sequence = slot.Sequence.load(std::memory_order_acquire);
+            bool result = ((sequence != 0) && ((sequence & 1) == 0));
+
+            if (result == true) {
+                record.Operation = slot.Operation.load(std::memory_order_relaxed);
+                record.Thread = slot.Thread.load(std::memory_order_relaxed);
+                record.Begin = slot.Begin.load(std::memory_order_relaxed);
+                record.Acquired = slot.Acquired.load(std::memory_order_relaxed);
+                record.Invoked = slot.Invoked.load(std::memory_order_relaxed);
+                record.End = slot.End.load(std::memory_order_relaxed);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                result = (slot.Sequence.load(std::memory_order_relaxed) == sequence);
+            }
+
+            return (result);
+        }
+        static void Event(FILE* output, const bool first, const char* name, const uint32_t thread, const uint64_t start, const uint64_t duration)
+        {
+            fprintf(output, "%s\n{\"name\":\"%s\",\"cat\":\"dictionary\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                (first ? "" : ","), name, thread, start / 1000.0, duration / 1000.0);
+        }
+
+    private:
+        const uint32_t _mask;
+        std::unique_ptr<Slot[]> _slots;
+        std::atomic<uint64_t> _head;
+        std::atomic<uint32_t> _threads;
+    };
+}
@@ -0,0 +1,948 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <core/core.h>
+#include <com/com.h>
+#include <interfaces/IDictionary.h>
+#include "CallTrace.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Thunder {
+
+    class Dictionary : public RPC::SmartInterfaceType<Exchange::IDictionary > {
+    public:
+        enum operation : uint8_t {
+            GET,
+            SET,
+            GET_MANY,
+            SET_MANY,
+            PATH_ENTRIES,
+            UNREGISTER,
+            OPERATIONS
+        };
+
+    private:
+        using BaseClass = RPC::SmartInterfaceType<Exchange::IDictionary >;
+
+        class Notification : public Exchange::IDictionary::INotification {
+        public:
+            Notification() = delete;
+            Notification(const Notification&) = delete;
+            Notification& operator=(const Notification&) = delete;
+
+            Notification(Dictionary& parent)
+                : _parent(parent)
+            {
+            }
+            ~Notification() override = default;
+
+        public:
+            void Modified(const string& nameSpace, const string& key, const string& /* value */) override
+            {
+                _parent.Invalidate(nameSpace, key);
+            }
+
+            BEGIN_INTERFACE_MAP(Notification)
+                INTERFACE_ENTRY(Exchange::IDictionary::INotification)
+            END_INTERFACE_MAP
+
+        private:
+            Dictionary& _parent;
+        };
+
+        // The interface for the duration of one operation, either the pinned one or, if there is
+        // none, one taken (and released again) through the SmartInterfaceType.
+        class Access {
+        public:
+            Access() = delete;
+            Access(const Access&) = delete;
+            Access& operator=(const Access&) = delete;
+
+            Access(const Dictionary& parent, const operation type)
+                : _parent(parent)
+                , _operation(type)
+                , _pinned(false)
+                , _impl(nullptr)
+                , _begin(0)
+                , _acquired(0)
+            {
+                if ((parent._profiling.load() == false) && (parent._tracing.load() == false)) {
+                    _impl = parent.Take(_pinned);
+                }
+                else {
+                    _begin = Now();
+                    _impl = parent.Take(_pinned);
+                    _acquired = Now();
+
+                    if (parent._profiling.load() == true) {
+                        parent.Acquired(_acquired - _begin);
+                    }
+                }
+            }
+            ~Access()
+            {
+                if (_begin == 0) {
+                    _parent.Give(_impl, _pinned);
+                }
+                else {
+                    uint64_t invoked = Now();
+                    _parent.Give(_impl, _pinned);
+
+                    if (_parent._tracing.load() == true) {
+                        _parent._trace->Add(_operation, _begin, _acquired, invoked, Now());
+                    }
+                }
+            }
+
+        public:
+            bool IsValid() const
+            {
+                return (_impl != nullptr);
+            }
+            Exchange::IDictionary* operator->() const
+            {
+                return (_impl);
+            }
+            Exchange::IDictionary* Interface() const
+            {
+                return (_impl);
+            }
+
+        private:
+            const Dictionary& _parent;
+            const operation _operation;
+            bool _pinned;
+            Exchange::IDictionary* _impl;
+            uint64_t _begin;
+            uint64_t _acquired;
+        };
+
+    public:
+        struct CacheStatistics {
+            uint64_t Hits;
+            uint64_t Misses;
+            uint64_t Invalidations;
+            uint32_t Entries;
+        };
+        struct WriteStatistics {
+            uint64_t Accepted; // Sets taken in by the write-behind
+            uint64_t Coalesced; // of which overwrote a write that was not flushed yet
+            uint64_t Flushed; // remote Sets actually issued
+            uint64_t Failed;
+            uint64_t Batches;
+            uint32_t Unflushed; // bytes waiting
+        };
+        struct AcquireStatistics {
+            uint64_t Count;
+            uint64_t Total; // nanoseconds
+            uint64_t Max; // nanoseconds
+        };
+
+    public:
+        struct Entry {
+            Entry()
+                : NameSpace()
+                , Key()
+                , Value()
+                , Valid(false)
+            {
+            }
+            Entry(const string& nameSpace, const string& key, const string& value = string())
+                : NameSpace(nameSpace)
+                , Key(key)
+                , Value(value)
+                , Valid(false)
+            {
+            }
+
+            string NameSpace;
+            string Key;
+            string Value;
+            bool Valid; // set by GetMany/SetMany if this entry succeeded
+        };
+
+        // Walks a namespace and everything below it, a page at a time. Only the iterator of the
+        // namespace being walked and the names of the namespaces still to visit are kept, so the
+        // memory used does not grow with the number of entries. Entries are fetched as the pages
+        // are requested: one call per name, to step the remote iterator, and one per value. At the
+        // end of each namespace the entry count is checked, so a lost link fails the scan.
+        class Scanner {
+        public:
+            Scanner() = delete;
+            Scanner(const Scanner&) = delete;
+            Scanner& operator=(const Scanner&) = delete;
+
+            Scanner(const Dictionary& parent, const string& nameSpace, const uint16_t pageSize)
+                : _parent(parent)
+                , _pageSize(pageSize == 0 ? 1 : pageSize)
+                , _current()
+                , _waiting(1, nameSpace)
+                , _iterator(nullptr)
+                , _stepped(0)
+                , _failed(false)
+            {
+            }
+            ~Scanner()
+            {
+                if (_iterator != nullptr) {
+                    _iterator->Release();
+                }
+            }
+
+        public:
+            // Fills <page> with the next entries, values included, returns false once all are done.
+            bool Next(std::vector<Entry>& page)
+            {
+                page.clear();
+
+                while ((page.size() < _pageSize) && (_failed == false) && ((_iterator != nullptr) || (_waiting.empty() == false))) {
+                    if (_iterator == nullptr) {
+                        _current = _waiting.back();
+                        _waiting.pop_back();
+                        Open();
+                    }
+                    else {
+                        Exchange::IDictionary::PathEntry entry;
+
+                        if (_iterator->Next(entry) == false) {
+                            // A call that did not get through also returns false, it is only the
+                            // end if the link is still up and all entries were seen.
+                            if ((_parent.IsOperational() == false) || (_iterator->Count() != _stepped)) {
+                                _failed = true;
+                            }
+                            _iterator->Release();
+                            _iterator = nullptr;
+                        }
+                        else {
+                            _stepped++;
+
+                            if (entry.type == Exchange::IDictionary::KEY) {
+                                page.emplace_back(_current, entry.name);
+                            }
+                            else {
+                                _waiting.push_back(_current + ((_current.empty() == false) && (_current.back() == '/') ? _T("") : _T("/")) + entry.name);
+                            }
+                        }
+                    }
+                }
+
+                if (page.empty() == false) {
+                    _parent.GetMany(page);
+                }
+
+                return (page.empty() == false);
+            }
+            // The scan stopped early, e.g. because the dictionary went away while walking it.
+            bool Failed() const
+            {
+                return (_failed);
+            }
+
+        private:
+            void Open()
+            {
+                Access impl(_parent, PATH_ENTRIES);
+
+                _stepped = 0;
+
+                if ((impl.IsValid() == false) || (impl->PathEntries(_current, _iterator) != Core::ERROR_NONE)) {
+                    _iterator = nullptr;
+                    _failed = true;
+                }
+            }
+
+        private:
+            const Dictionary& _parent;
+            const uint16_t _pageSize;
+            string _current;
+            std::vector<string> _waiting;
+            Exchange::IDictionary::IPathIterator* _iterator;
+            uint32_t _stepped; // entries taken from _iterator
+            bool _failed;
+        };
+
+    public:
+        Dictionary(const uint32_t waitTime, const Core::NodeId& node, const string& callsign)
+            : BaseClass()
+            , _cacheLock()
+            , _cache()
+            , _subscriptions()
+            , _generation(0)
+            , _caching(false)
+            , _hits(0)
+            , _misses(0)
+            , _invalidations(0)
+            , _sink(*this)
+            , _pinLock()
+            , _pinned(nullptr)
+            , _users(0)
+            , _retired()
+            , _retiring(false)
+            , _operational(false)
+            , _pinning(false)
+            , _writeLock()
+            , _flushLock()
+            , _writeSignal()
+            , _pending()
+            , _flushing()
+            , _unflushed(0)
+            , _window(0)
+            , _maxUnflushed(0)
+            , _writer()
+            , _writerStopped(false)
+            , _writes()
+            , _profiling(false)
+            , _acquisitions(0)
+            , _acquireTotal(0)
+            , _acquireMax(0)
+            , _tracing(false)
+            , _trace()
+            , _linkLock()
+            , _linkChanged()
+            , _linkUp(false)
+            , _transitions(0) {
+            uint32_t result = BaseClass::Open(waitTime, node, callsign);
+            printf("SmartInterfaceType Open returned %u", result);
+        }
+        ~Dictionary() {
+            WriteBehind(0, 0);
+            Unsubscribe();
+            Unpin();
+            BaseClass::Close(Core::infinite);
+        }
+
+    public:
+        // The value is assigned into <value>, so a caller that reuses one string for large values
+        // keeps its storage and saves an allocation per call.
+        bool Get(const string& nameSpace, const string& key, string& value ) const {
+            bool result = false;
+            bool cacheable = false;
+            uint64_t generation = 0;
+
+            if (_window.load() != 0) {
+                std::unique_lock<std::mutex> guard(_writeLock);
+                // Read-your-writes: what is not (completely) flushed yet, is the latest value.
+                if ((Unflushed(_pending, nameSpace, key, value) == true) || (Unflushed(_flushing, nameSpace, key, value) == true)) {
+                    return (true);
+                }
+            }
+
+            if (_caching.load() == true) {
+                _cacheLock.Lock();
+                std::unordered_map<string, string>::const_iterator entry(_cache.find(CacheKey(nameSpace, key)));
+                if (entry != _cache.end()) {
+                    value = entry->second;
+                    result = true;
+                }
+                generation = _generation;
+                _cacheLock.Unlock();
+
+                if (result == true) {
+                    _hits++;
+                    return (result);
+                }
+
+                _misses++;
+            }
+
+            Access impl(*this, GET);
+
+            if (impl.IsValid() == true) {
+                if (_caching.load() == true) {
+                    // Only with the change notifications in place, can a value be cached safely.
+                    cacheable = Subscribe(impl.Interface(), nameSpace);
+                }
+
+                if(impl->Get(nameSpace, key, value) == Core::ERROR_NONE)
+                {
+                    result = true;
+                }
+            }
+
+            if ((result == true) && (cacheable == true)) {
+                _cacheLock.Lock();
+                // If anything changed while we were asking, what we got may already be stale.
+                if (generation == _generation) {
+                    _cache[CacheKey(nameSpace, key)] = value;
+                }
+                _cacheLock.Unlock();
+            }
+
+            return (result);
+        }
+        bool Set(const string& nameSpace, const string& key, const string& value) {
+            if ((_window.load() != 0) && (Defer(nameSpace, key, value) == true)) {
+                return (true);
+            }
+
+            bool result = false;
+            Access impl(*this, SET);
+
+            if (impl.IsValid() == true) {
+                if(impl->Set(nameSpace, key, value) == Core::ERROR_NONE)
+                {
+                    result = true;
+                }
+
+                Invalidate(nameSpace, key);
+            }
+            else
+            {
+                printf("impl nullptr \n");
+            }
+            return (result);
+        }
+
+        // Blocks until the link is (or is no longer) operational, returns false if that did not
+        // happen within <waitTime> ms.
+        bool WaitForOperational(const bool upAndRunning, const uint32_t waitTime) const {
+            std::unique_lock<std::mutex> guard(_linkLock);
+            return (_linkChanged.wait_for(guard, std::chrono::milliseconds(waitTime), [&]() { return (_linkUp == upAndRunning); }));
+        }
+        // Number of Operational() notifications received so far.
+        uint32_t Transitions() const {
+            std::unique_lock<std::mutex> guard(_linkLock);
+            return (_transitions);
+        }
+
+        // Record every call that reaches the interface, with the time it took to get hold of the
+        // interface, to invoke it (marshalling, transport and the plugin itself) and to release
+        // it again. Calls served from the cache or deferred by the write-behind are not included.
+        // The ring holding the last <slots> calls is allocated the first time and kept from then on.
+        void Tracing(const bool enabled, const uint32_t slots = 65536) {
+            if ((enabled == true) && (_trace == nullptr)) {
+                _trace.reset(new CallTrace(slots));
+            }
+            _tracing = enabled;
+        }
+        bool Tracing() const {
+            return (_tracing.load());
+        }
+        // Writes the recorded calls as a Chrome trace, returns the number of calls written.
+        uint32_t DumpTrace(const string& fileName) const {
+            static const TCHAR* names[OPERATIONS] = {
+                _T("Get"),
+                _T("Set"),
+                _T("GetMany"),
+                _T("SetMany"),
+                _T("PathEntries"),
+                _T("Unregister")
+            };
+
+            return (_trace == nullptr ? 0 : _trace->Dump(fileName, names, OPERATIONS));
+        }
+        // Calls traced so far, more than DumpTrace() writes once the oldest were overwritten.
+        uint64_t TraceRecorded() const {
+            return (_trace == nullptr ? 0 : _trace->Recorded());
+        }
+
+        // Measure how long every operation waits to get hold of the interface, which is where
+        // threads sharing this dictionary contend.
+        void Profiling(const bool enabled) {
+            _profiling = enabled;
+        }
+        bool Profiling() const {
+            return (_profiling.load());
+        }
+        AcquireStatistics Acquisitions() const {
+            AcquireStatistics result;
+            result.Count = _acquisitions.load();
+            result.Total = _acquireTotal.load();
+            result.Max = _acquireMax.load();
+            return (result);
+        }
+        void ResetAcquisitions() {
+            _acquisitions = 0;
+            _acquireTotal = 0;
+            _acquireMax = 0;
+        }
+
+        // Write-behind: a Set only records the value, the background writer sends it after at most
+        // <window> ms. Writes to the same key within that time are coalesced, only the last value
+        // is sent. Once <maxUnflushed> bytes are waiting, the Set flushes in the calling thread.
+        // Writes that fail at flush time can not be reported to the caller, they are only counted.
+        // A window of 0 flushes what is waiting and returns to synchronous Sets.
+        void WriteBehind(const uint32_t window, const uint32_t maxUnflushed) {
+            {
+                // Once the window is 0, Defer() refuses, so nothing is left behind after the Flush().
+                std::unique_lock<std::mutex> guard(_writeLock);
+                _maxUnflushed = maxUnflushed;
+                _window = window;
+                _writerStopped = true;
+            }
+
+            if (_writer.joinable() == true) {
+                _writeSignal.notify_all();
+                _writer.join();
+            }
+
+            Flush();
+
+            if (window != 0) {
+                _writerStopped = false;
+                _writer = std::thread(&Dictionary::Writer, this);
+            }
+        }
+        uint32_t WriteBehind() const {
+            return (_window.load());
+        }
+        // Sends everything that is waiting, returns the number of writes that failed.
+        uint32_t Flush() {
+            std::unique_lock<std::mutex> flushing(_flushLock);
+            std::vector<Entry> batch;
+
+            {
+                std::unique_lock<std::mutex> guard(_writeLock);
+                _flushing.swap(_pending);
+                _unflushed = 0;
+                batch.reserve(_flushing.size());
+                for (const std::pair<const string, Entry>& entry : _flushing) {
+                    batch.push_back(entry.second);
+                }
+            }
+
+            uint32_t failed = 0;
+
+            if (batch.empty() == false) {
+                failed = static_cast<uint32_t>(batch.size()) - SetMany(batch);
+
+                std::unique_lock<std::mutex> guard(_writeLock);
+                _flushing.clear();
+                _writes.Flushed += batch.size();
+                _writes.Failed += failed;
+                _writes.Batches++;
+            }
+
+            return (failed);
+        }
+        WriteStatistics WriteBehindStatistics() const {
+            std::unique_lock<std::mutex> guard(_writeLock);
+            WriteStatistics result(_writes);
+            result.Unflushed = _unflushed;
+            return (result);
+        }
+
+        // Serve repeated Gets from a local copy. Entries are dropped as soon as the dictionary
+        // reports a change, for which we register on every namespace read through the cache.
+        void Caching(const bool enabled) {
+            _caching = enabled;
+
+            if (enabled == false) {
+                Clear();
+            }
+        }
+        bool Caching() const {
+            return (_caching.load());
+        }
+
+        // Keep one reference to the remote interface for as long as it is operational, instead of
+        // taking it (lock + AddRef) and releasing it again for every operation.
+        void Pinning(const bool enabled) {
+            _pinning = enabled;
+
+            if (enabled == false) {
+                Unpin();
+            }
+        }
+        bool Pinning() const {
+            return (_pinning.load());
+        }
+        CacheStatistics Statistics() const {
+            CacheStatistics result;
+
+            _cacheLock.Lock();
+            result.Entries = static_cast<uint32_t>(_cache.size());
+            _cacheLock.Unlock();
+
+            result.Hits = _hits.load();
+            result.Misses = _misses.load();
+            result.Invalidations = _invalidations.load();
+
+            return (result);
+        }
+
+        // The IDictionary has no multi-key methods, so every entry is still a call of its own. What
+        // these save is taking the interface (lock + AddRef) and releasing it again for every key,
+        // and the batch is executed against one and the same remote instance (with pinning enabled
+        // the former is already saved on every call). GetMany always reads
+        // the remote values, it does not consult the cache.
+        uint32_t GetMany(std::vector<Entry>& entries) const {
+            uint32_t succeeded = 0;
+            Access impl(*this, GET_MANY);
+
+            if (impl.IsValid() == true) {
+                for (Entry& entry : entries) {
+                    entry.Valid = (impl->Get(entry.NameSpace, entry.Key, entry.Value) == Core::ERROR_NONE);
+                    succeeded += (entry.Valid ? 1 : 0);
+                }
+            }
+            else {
+                for (Entry& entry : entries) {
+                    entry.Valid = false;
+                }
+            }
+
+            return (succeeded);
+        }
+        uint32_t SetMany(std::vector<Entry>& entries) {
+            uint32_t succeeded = 0;
+            Access impl(*this, SET_MANY);
+
+            if (impl.IsValid() == true) {
+                for (Entry& entry : entries) {
+                    entry.Valid = (impl->Set(entry.NameSpace, entry.Key, entry.Value) == Core::ERROR_NONE);
+                    succeeded += (entry.Valid ? 1 : 0);
+                    Invalidate(entry.NameSpace, entry.Key);
+                }
+            }
+            else {
+                for (Entry& entry : entries) {
+                    entry.Valid = false;
+                }
+            }
+
+            return (succeeded);
+        }
+
+        void Trigger()
+        {
+            Exchange::IDictionary* impl = BaseClass::Interface();
+
+            if (impl != nullptr) {
+                printf("Release 1\n");
+                impl->Release();
+                printf("Release 2\n");
+                impl->Release();
+            }
+        }
+
+
+    private:
+        void Operational(const bool upAndRunning) {
+            printf("Operational state of Dictionary: %s\n", upAndRunning ? _T("true") : _T("false"));
+
+            _pinLock.Lock();
+            _operational = upAndRunning;
+            _pinLock.Unlock();
+
+            {
+                std::unique_lock<std::mutex> guard(_linkLock);
+                _linkUp = upAndRunning;
+                _transitions++;
+            }
+            _linkChanged.notify_all();
+
+            if (upAndRunning == false) {
+                Unpin();
+
+                // Whatever was cached or registered belonged to the instance that is gone.
+                _cacheLock.Lock();
+                _subscriptions.clear();
+                _cacheLock.Unlock();
+                Clear();
+            }
+        }
+
+        static uint64_t Now() {
+            return (static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()));
+        }
+        void Acquired(const uint64_t duration) const {
+            _acquisitions.fetch_add(1, std::memory_order_relaxed);
+            _acquireTotal.fetch_add(duration, std::memory_order_relaxed);
+
+            uint64_t max = _acquireMax.load(std::memory_order_relaxed);
+            while ((duration > max) && (_acquireMax.compare_exchange_weak(max, duration, std::memory_order_relaxed) == false)) {
+            }
+        }
+        static bool Unflushed(const std::unordered_map<string, Entry>& writes, const string& nameSpace, const string& key, string& value) {
+            std::unordered_map<string, Entry>::const_iterator entry(writes.find(CacheKey(nameSpace, key)));
+            bool result = (entry != writes.end());
+
+            if (result == true) {
+                value = entry->second.Value;
+            }
+
+            return (result);
+        }
+        // Returns false if write-behind was switched off since the caller looked, the Set is then
+        // to be done synchronously.
+        bool Defer(const string& nameSpace, const string& key, const string& value) {
+            bool full = false;
+            {
+                std::unique_lock<std::mutex> guard(_writeLock);
+
+                if (_window.load() == 0) {
+                    return (false);
+                }
+
+                std::pair<std::unordered_map<string, Entry>::iterator, bool> entry(_pending.emplace(CacheKey(nameSpace, key), Entry(nameSpace, key)));
+
+                if (entry.second == false) {
+                    _unflushed -= static_cast<uint32_t>(entry.first->second.Value.size());
+                    _writes.Coalesced++;
+                }
+                else {
+                    _unflushed += static_cast<uint32_t>(nameSpace.size() + key.size());
+                }
+                entry.first->second.Value = value;
+                _unflushed += static_cast<uint32_t>(value.size());
+                _writes.Accepted++;
+
+                full = (_unflushed >= _maxUnflushed);
+            }
+
+            if (full == true) {
+                Flush();
+            }
+            else {
+                _writeSignal.notify_one();
+            }
+
+            return (true);
+        }
+        void Writer() {
+            std::unique_lock<std::mutex> guard(_writeLock);
+
+            while (_writerStopped == false) {
+                _writeSignal.wait(guard, [this]() { return ((_writerStopped == true) || (_pending.empty() == false)); });
+
+                if (_writerStopped == false) {
+                    // The window starts with the first write that is waiting, not with the last one,
+                    // so a key that is written continuously still gets out in time.
+                    _writeSignal.wait_for(guard, std::chrono::milliseconds(_window.load()), [this]() { return (_writerStopped == true); });
+
+                    guard.unlock();
+                    Flush();
+                    guard.lock();
+                }
+            }
+        }
+
+        Exchange::IDictionary* Take(bool& pinned) const {
+            Exchange::IDictionary* result = nullptr;
+
+            if (_pinning.load() == true) {
+                _users.fetch_add(1);
+
+                result = _pinned.load();
+
+                if ((result == nullptr) && (Pin() == true)) {
+                    result = _pinned.load();
+                }
+
+                if (result == nullptr) {
+                    Leave();
+                }
+            }
+
+            pinned = (result != nullptr);
+
+            if (pinned == false) {
+                result = const_cast<Dictionary&>(*this).BaseClass::Interface();
+            }
+
+            return (result);
+        }
+        void Give(Exchange::IDictionary* impl, const bool pinned) const {
+            if (pinned == true) {
+                Leave();
+            }
+            else if (impl != nullptr) {
+                impl->Release();
+            }
+        }
+        // The interface is taken lazily, on the first call after the link became operational, so
+        // it is never requested from within the Operational() notification itself.
+        bool Pin() const {
+            _pinLock.Lock();
+
+            if ((_operational == true) && (_pinning.load() == true) && (_pinned.load() == nullptr)) {
+                _pinned.store(const_cast<Dictionary&>(*this).BaseClass::Interface());
+            }
+
+            bool result = (_pinned.load() != nullptr);
+
+            _pinLock.Unlock();
+
+            return (result);
+        }
+        // Once the pointer is cleared no new user can pick it up. The reference is retired and
+        // dropped by whoever sees the last user of it leave, so this never waits for a call that
+        // may be stuck on a server that went away (it runs from the Operational() notification).
+        void Unpin() {
+            _pinLock.Lock();
+            Exchange::IDictionary* impl = _pinned.exchange(nullptr);
+            if (impl != nullptr) {
+                _retired.push_back(impl);
+                _retiring = true;
+            }
+            _pinLock.Unlock();
+
+            if (impl != nullptr) {
+                Retire();
+            }
+        }
+        void Leave() const {
+            if ((_users.fetch_sub(1) == 1) && (_retiring.load() == true)) {
+                Retire();
+            }
+        }
+        // Users count themselves before they pick up the pinned pointer, so once there are none
+        // left after a reference was retired, nobody can still be using it.
+        void Retire() const {
+            std::vector<Exchange::IDictionary*> retired;
+
+            _pinLock.Lock();
+            if (_users.load() == 0) {
+                retired.swap(_retired);
+                _retiring = false;
+            }
+            _pinLock.Unlock();
+
+            for (Exchange::IDictionary* impl : retired) {
+                impl->Release();
+            }
+        }
+
+        static string CacheKey(const string& nameSpace, const string& key) {
+            return (nameSpace + '\n' + key);
+        }
+        void Invalidate(const string& nameSpace, const string& key) const {
+            _cacheLock.Lock();
+            _generation++;
+            if (_cache.erase(CacheKey(nameSpace, key)) != 0) {
+                _invalidations++;
+            }
+            _cacheLock.Unlock();
+        }
+        void Clear() const {
+            _cacheLock.Lock();
+            _generation++;
+            _cache.clear();
+            _cacheLock.Unlock();
+        }
+        // Returns true once the notification sink is registered for this namespace. Registering
+        // may call back into us, so it is never done with the _cacheLock taken.
+        bool Subscribe(Exchange::IDictionary* impl, const string& nameSpace) const {
+            bool result = false;
+            bool registering = false;
+
+            _cacheLock.Lock();
+            std::map<string, bool>::iterator subscription(_subscriptions.find(nameSpace));
+            if (subscription == _subscriptions.end()) {
+                _subscriptions.emplace(nameSpace, false);
+                registering = true;
+            }
+            else {
+                result = subscription->second;
+            }
+            _cacheLock.Unlock();
+
+            if (registering == true) {
+                result = (impl->Register(nameSpace, const_cast<Core::SinkType<Notification>*>(&_sink)) == Core::ERROR_NONE);
+
+                _cacheLock.Lock();
+                if (result == true) {
+                    _subscriptions[nameSpace] = true;
+                }
+                else {
+                    _subscriptions.erase(nameSpace);
+                }
+                _cacheLock.Unlock();
+            }
+
+            return (result);
+        }
+        void Unsubscribe() {
+            std::vector<string> nameSpaces;
+
+            _cacheLock.Lock();
+            for (const std::pair<const string, bool>& subscription : _subscriptions) {
+                if (subscription.second == true) {
+                    nameSpaces.push_back(subscription.first);
+                }
+            }
+            _subscriptions.clear();
+            _cacheLock.Unlock();
+
+            Access impl(*this, UNREGISTER);
+
+            if (impl.IsValid() == true) {
+                for (const string& nameSpace : nameSpaces) {
+                    impl->Unregister(nameSpace, &_sink);
+                }
+            }
+        }
+
+    private:
+        mutable Core::CriticalSection _cacheLock;
+        mutable std::unordered_map<string, string> _cache;
+        mutable std::map<string, bool> _subscriptions;
+        mutable uint64_t _generation;
+        std::atomic<bool> _caching;
+        mutable std::atomic<uint64_t> _hits;
+        mutable std::atomic<uint64_t> _misses;
+        mutable std::atomic<uint64_t> _invalidations;
+        Core::SinkType<Notification> _sink;
+
+        mutable Core::CriticalSection _pinLock;
+        mutable std::atomic<Exchange::IDictionary*> _pinned;
+        mutable std::atomic<uint32_t> _users;
+        mutable std::vector<Exchange::IDictionary*> _retired; // unpinned, still in use
+        mutable std::atomic<bool> _retiring;
+        bool _operational;
+        std::atomic<bool> _pinning;
+
+        mutable std::mutex _writeLock;
+        std::mutex _flushLock;
+        std::condition_variable _writeSignal;
+        std::unordered_map<string, Entry> _pending;
+        std::unordered_map<string, Entry> _flushing;
+        uint32_t _unflushed;
+        std::atomic<uint32_t> _window;
+        uint32_t _maxUnflushed;
+        std::thread _writer;
+        bool _writerStopped;
+        WriteStatistics _writes;
+
+        std::atomic<bool> _profiling;
+        mutable std::atomic<uint64_t> _acquisitions;
+        mutable std::atomic<uint64_t> _acquireTotal;
+        mutable std::atomic<uint64_t> _acquireMax;
+
+        std::atomic<bool> _tracing;
+        std::unique_ptr<CallTrace> _trace;
+
+        mutable std::mutex _linkLock;
+        mutable std::condition_variable _linkChanged;
+        bool _linkUp;
+        uint32_t _transitions;
+    };
+
+}
@@ -28,85 +28,858 @@
 #include <definitions/definitions.h>
 #include <plugins/Types.h>
 #include <interfaces/IDictionary.h>
+#include "Dictionary.h"
+#include "../TrivialCOMRPC/client/Platform.h"
+#include "../TrivialCOMRPC/client/Statistics.h"
+#include <atomic>
 #include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
 
 MODULE_NAME_DECLARATION(BUILD_REFERENCE)
 
 using namespace Thunder;
 
 
-class Dictionary : public RPC::SmartInterfaceType<Exchange::IDictionary > {
-private:
-    using BaseClass = RPC::SmartInterfaceType<Exchange::IDictionary >;
-public:
-    Dictionary(const uint32_t waitTime, const Core::NodeId& node, const string& callsign)
-        : BaseClass() {
-        uint32_t result = BaseClass::Open(waitTime, node, callsign);
-	printf("SmartInterfaceType Open returned %u",result);
+struct LoadOptions {
+    LoadOptions()
+        : Enabled(false)
+        , Overhead(false)
+        , Stress(false)
+        , Values(false)
+        , Scan()
+        , Export()
+        , PageSize(256)
+        , Trace()
+        , Cycles(0)
+        , ServerPid(0)
+        , Operations(100000)
+        , Threads(1)
+        , Keys(1000)
+        , Namespaces(1)
+        , MinValueSize(8)
+        , MaxValueSize(64)
+        , ReadPercentage(80)
+        , Cache(false)
+        , Pin(false)
+        , Window(0)
+        , MaxUnflushed(1024 * 1024)
+        , Format(Benchmark::Format::TEXT)
+        , Output()
+        , Label(_T("TestClient"))
+    {
     }
-    ~Dictionary() {
-        BaseClass::Close(Core::infinite);
+
+    bool Enabled;
+    bool Overhead;
+    bool Stress;
+    bool Values;
+    string Scan; // namespace to export, empty is no scan
+    string Export; // file the scan is exported to, empty is the console
+    uint16_t PageSize;
+    string Trace; // Chrome trace of the non-interactive run, empty is no trace
+    uint32_t Cycles; // reconnect cycles, 0 is no reconnect run
+    uint32_t ServerPid;
+    uint32_t Operations; // per thread
+    uint32_t Threads;
+    uint32_t Keys; // per namespace
+    uint32_t Namespaces;
+    uint32_t MinValueSize;
+    uint32_t MaxValueSize;
+    uint8_t ReadPercentage;
+    bool Cache;
+    bool Pin;
+    uint32_t Window; // ms, 0 is synchronous Sets
+    uint32_t MaxUnflushed;
+    Benchmark::Format Format;
+    string Output;
+    string Label;
+};
+
+bool ParseOptions(int argc, char** argv, LoadOptions& load)
+{
+    int index = 1;
+    bool showHelp = false;
+
+    while ((index < argc) && (!showHelp)) {
+        if ((index + 1) >= argc) {
+            showHelp = true;
+        }
+        else if (strcmp(argv[index], "-load") == 0) {
+            load.Enabled = true;
+            load.Operations = atoi(argv[index + 1]);
+        }
+        else if (strcmp(argv[index], "-overhead") == 0) {
+            load.Overhead = true;
+            load.Operations = atoi(argv[index + 1]);
+        }
+        else if (strcmp(argv[index], "-stress") == 0) {
+            load.Stress = true;
+            load.Operations = atoi(argv[index + 1]);
+        }
+        else if (strcmp(argv[index], "-values") == 0) {
+            load.Values = true;
+            load.Operations = atoi(argv[index + 1]);
+        }
+        else if (strcmp(argv[index], "-scan") == 0) {
+            load.Scan = argv[index + 1];
+        }
+        else if (strcmp(argv[index], "-export") == 0) {
+            load.Export = argv[index + 1];
+        }
+        else if (strcmp(argv[index], "-page") == 0) {
+            load.PageSize = static_cast<uint16_t>(std::min(std::max(atoi(argv[index + 1]), 1), 0xFFFF));
+        }
+        else if (strcmp(argv[index], "-reconnect") == 0) {
+            load.Cycles = std::max(atoi(argv[index + 1]), 1);
+        }
+        else if (strcmp(argv[index], "-pid") == 0) {
+            load.ServerPid = atoi(argv[index + 1]);
+        }
+        else if (strcmp(argv[index], "-threads") == 0) {
+            load.Threads = std::max(atoi(argv[index + 1]), 1);
+        }
+        else if (strcmp(argv[index], "-keys") == 0) {
+            load.Keys = std::max(atoi(argv[index + 1]), 1);
+        }
+        else if (strcmp(argv[index], "-namespaces") == 0) {
+            load.Namespaces = std::max(atoi(argv[index + 1]), 1);
+        }
+        else if (strcmp(argv[index], "-value") == 0) {
+            // <size> or <min>:<max>, the size of each value written is picked uniformly in between.
+            const char* separator = strchr(argv[index + 1], ':');
+            load.MinValueSize = atoi(argv[index + 1]);
+            load.MaxValueSize = (separator != nullptr ? atoi(separator + 1) : load.MinValueSize);
+            showHelp = (load.MaxValueSize < load.MinValueSize);
+        }
+        else if (strcmp(argv[index], "-reads") == 0) {
+            load.ReadPercentage = static_cast<uint8_t>(std::min(std::max(atoi(argv[index + 1]), 0), 100));
+        }
+        else if (strcmp(argv[index], "-cache") == 0) {
+            load.Cache = (strcmp(argv[index + 1], "on") == 0);
+            showHelp = ((load.Cache == false) && (strcmp(argv[index + 1], "off") != 0));
+        }
+        else if (strcmp(argv[index], "-pin") == 0) {
+            load.Pin = (strcmp(argv[index + 1], "on") == 0);
+            showHelp = ((load.Pin == false) && (strcmp(argv[index + 1], "off") != 0));
+        }
+        else if (strcmp(argv[index], "-writebehind") == 0) {
+            // <window> or <window>:<bytes>
+            const char* separator = strchr(argv[index + 1], ':');
+            load.Window = atoi(argv[index + 1]);
+            if (separator != nullptr) {
+                load.MaxUnflushed = std::max(atoi(separator + 1), 1);
+            }
+        }
+        else if (strcmp(argv[index], "-trace") == 0) {
+            load.Trace = argv[index + 1];
+        }
+        else if (strcmp(argv[index], "-format") == 0) {
+            showHelp = (Benchmark::ParseFormat(argv[index + 1], load.Format) == false);
+        }
+        else if (strcmp(argv[index], "-output") == 0) {
+            load.Output = argv[index + 1];
+        }
+        else if (strcmp(argv[index], "-label") == 0) {
+            load.Label = argv[index + 1];
+        }
+        else {
+            showHelp = true;
+        }
+        index += 2;
     }
 
-public:
-    bool Get(const string& nameSpace, const string& key, string& value ) const {
-        bool result = false;
-        const Exchange::IDictionary* impl = BaseClass::Interface();
+    return (showHelp);
+}
+
+string NameSpace(const uint32_t index)
+{
+    return (_T("/load") + Core::NumberType<uint32_t>(index).Text());
+}
+
+string Key(const uint32_t index)
+{
+    return (_T("key") + Core::NumberType<uint32_t>(index).Text());
+}
+
+void ReportWrites(FILE* output, const Dictionary& dictionary)
+{
+    Dictionary::WriteStatistics writes(dictionary.WriteBehindStatistics());
+    fprintf(output, "Write-behind: %llu accepted, %llu coalesced, %llu flushed in %llu batches, %llu failed, %u bytes waiting\n",
+        static_cast<unsigned long long>(writes.Accepted), static_cast<unsigned long long>(writes.Coalesced),
+        static_cast<unsigned long long>(writes.Flushed), static_cast<unsigned long long>(writes.Batches),
+        static_cast<unsigned long long>(writes.Failed), writes.Unflushed);
+}
 
-        if (impl != nullptr) {
-            if(impl->Get(nameSpace, key, value) == Core::ERROR_NONE)
-            {
-                result = true;
+// Reads of keys that were never written are not representative, so make sure all exist.
+void Populate(Dictionary& dictionary, const LoadOptions& options)
+{
+    if (options.ReadPercentage > 0) {
+        string value(options.MinValueSize, 'v');
+        for (uint32_t space = 0; space < options.Namespaces; space++) {
+            for (uint32_t key = 0; key < options.Keys; key++) {
+                dictionary.Set(NameSpace(space), Key(key), value);
             }
-            impl->Release();
         }
+        dictionary.Flush();
+    }
+}
+
+// Runs the mixed Get/Set workload on <threads> threads, all sharing the one dictionary. Returns
+// the wall clock duration, deferred writes included, and the failures per operation.
+uint64_t Drive(Dictionary& dictionary, const LoadOptions& options, const uint32_t threads, std::vector<Benchmark::Latencies>& gets, std::vector<Benchmark::Latencies>& sets, uint64_t& getFailures, uint64_t& setFailures)
+{
+    std::vector<uint64_t> getFailed(threads, 0);
+    std::vector<uint64_t> setFailed(threads, 0);
+    std::vector<std::thread> workers;
+    std::atomic<bool> start(false);
+
+    gets.assign(threads, Benchmark::Latencies());
+    sets.assign(threads, Benchmark::Latencies());
+
+    for (uint32_t thread = 0; thread < threads; thread++) {
+        workers.emplace_back([&, thread]() {
+            std::mt19937 random(thread + 1);
+            std::uniform_int_distribution<uint32_t> spaces(0, options.Namespaces - 1);
+            std::uniform_int_distribution<uint32_t> keys(0, options.Keys - 1);
+            std::uniform_int_distribution<uint32_t> sizes(options.MinValueSize, options.MaxValueSize);
+            std::uniform_int_distribution<uint32_t> percentage(0, 99);
+            string payload(options.MaxValueSize, 'v');
+            string value;
+
+            gets[thread].Reserve((options.Operations * options.ReadPercentage) / 100);
+            sets[thread].Reserve((options.Operations * (100 - options.ReadPercentage)) / 100);
 
-        return (result);
+            while (start.load() == false) {
+                std::this_thread::yield();
+            }
+
+            for (uint32_t operation = 0; operation < options.Operations; operation++) {
+                string nameSpace(NameSpace(spaces(random)));
+                string key(Key(keys(random)));
+
+                if (percentage(random) < options.ReadPercentage) {
+                    uint64_t begin = Benchmark::Now();
+                    bool succeeded = dictionary.Get(nameSpace, key, value);
+                    gets[thread].Add(Benchmark::Now() - begin);
+                    getFailed[thread] += (succeeded ? 0 : 1);
+                }
+                else {
+                    value.assign(payload, 0, sizes(random));
+                    uint64_t begin = Benchmark::Now();
+                    bool succeeded = dictionary.Set(nameSpace, key, value);
+                    sets[thread].Add(Benchmark::Now() - begin);
+                    setFailed[thread] += (succeeded ? 0 : 1);
+                }
+            }
+        });
+    }
+
+    uint64_t begin = Benchmark::Now();
+    start = true;
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // Deferred writes are part of the work, the run is only over once they reached the dictionary.
+    // Those that fail here are failed Sets.
+    setFailures = dictionary.Flush();
+    getFailures = 0;
+    uint64_t duration = Benchmark::Now() - begin;
+
+    for (uint32_t thread = 0; thread < threads; thread++) {
+        getFailures += getFailed[thread];
+        setFailures += setFailed[thread];
     }
-    bool Set(const string& nameSpace, const string& key, const string& value) {
-        bool result = false;
-        Exchange::IDictionary* impl = BaseClass::Interface();
-	
-        if (impl != nullptr) {
-            if(impl->Set(nameSpace, key, value) == Core::ERROR_NONE)
-            {
-                result = true;
+
+    return (duration);
+}
+
+// Drives the dictionary from a number of threads, without any console output on the way, and
+// reports the throughput and the Get and Set latencies once all threads are done.
+int RunLoad(Dictionary& dictionary, const LoadOptions& options)
+{
+    std::vector<Benchmark::Latencies> gets;
+    std::vector<Benchmark::Latencies> sets;
+    uint64_t getFailures = 0;
+    uint64_t setFailures = 0;
+
+    Populate(dictionary, options);
+
+    uint64_t duration = Drive(dictionary, options, options.Threads, gets, sets, getFailures, setFailures);
+
+    Benchmark::Result getReport;
+    Benchmark::Result setReport;
+    getReport.Label = options.Label + _T("/get");
+    setReport.Label = options.Label + _T("/set");
+    getReport.Threads = setReport.Threads = options.Threads;
+    getReport.Duration = setReport.Duration = duration;
+
+    for (uint32_t thread = 0; thread < options.Threads; thread++) {
+        getReport.Samples.Merge(gets[thread]);
+        setReport.Samples.Merge(sets[thread]);
+    }
+    getReport.Calls = getReport.Samples.Count();
+    setReport.Calls = setReport.Samples.Count();
+    getReport.Failures = getFailures;
+    setReport.Failures = setFailures;
+
+    Benchmark::Output sink(options.Output);
+    FILE* output = sink.File();
+
+    Benchmark::Report(sink, options.Format, getReport);
+    Benchmark::Report(sink, options.Format, setReport);
+
+    if (options.Format == Benchmark::Format::TEXT) {
+        fprintf(output, "Total:        %.0f ops/s over %u namespace(s) of %u keys, values of %u-%u bytes, %u%% reads\n",
+            (getReport.Calls + setReport.Calls) / (duration / 1000000000.0),
+            options.Namespaces, options.Keys, options.MinValueSize, options.MaxValueSize, options.ReadPercentage);
+
+        if (dictionary.Caching() == true) {
+            Dictionary::CacheStatistics cache(dictionary.Statistics());
+            fprintf(output, "Cache:        %llu hits, %llu misses, %llu invalidations, %u entries\n",
+                static_cast<unsigned long long>(cache.Hits), static_cast<unsigned long long>(cache.Misses),
+                static_cast<unsigned long long>(cache.Invalidations), cache.Entries);
+        }
+        if (dictionary.WriteBehind() != 0) {
+            ReportWrites(output, dictionary);
+        }
+    }
+
+    return (((getFailures + setFailures) == 0) ? 0 : 1);
+}
+
+// Runs the load with 1, 2, 4, ... up to -threads threads sharing the one dictionary, to find where
+// adding threads stops adding throughput. Next to the throughput, it reports how long operations
+// waited to get hold of the interface, which is the part they can not do in parallel.
+int RunStress(Dictionary& dictionary, const LoadOptions& options)
+{
+    struct Step {
+        uint32_t Threads;
+        double Throughput;
+        Dictionary::AcquireStatistics Acquire;
+        uint64_t Busy; // nanoseconds spent in Get and Set, summed over all threads
+        uint64_t Failures;
+    };
+
+    const bool profiling = dictionary.Profiling();
+    std::vector<Step> steps;
+    uint64_t totalFailures = 0;
+    Benchmark::Output sink(options.Output);
+    FILE* output = sink.File();
+
+    Populate(dictionary, options);
+    dictionary.Profiling(true);
+
+    uint32_t threads = 1;
+
+    while (threads != 0) {
+        std::vector<Benchmark::Latencies> gets;
+        std::vector<Benchmark::Latencies> sets;
+        Step step;
+
+        dictionary.ResetAcquisitions();
+
+        uint64_t getFailures = 0;
+        uint64_t setFailures = 0;
+        uint64_t duration = Drive(dictionary, options, threads, gets, sets, getFailures, setFailures);
+
+        Benchmark::Result report;
+        report.Label = options.Label + _T("/stress");
+        report.Threads = threads;
+        report.Duration = duration;
+        step.Failures = getFailures + setFailures;
+        report.Failures = step.Failures;
+        for (uint32_t thread = 0; thread < threads; thread++) {
+            report.Samples.Merge(gets[thread]);
+            report.Samples.Merge(sets[thread]);
+        }
+        report.Calls = report.Samples.Count();
+
+        step.Threads = threads;
+        step.Throughput = report.Calls / (duration / 1000000000.0);
+        step.Acquire = dictionary.Acquisitions();
+        step.Busy = report.Samples.Mean() * report.Calls;
+        steps.push_back(step);
+        totalFailures += step.Failures;
+
+        Benchmark::Report(sink, options.Format, report);
+
+        if (threads == options.Threads) {
+            threads = 0;
+        }
+        else {
+            threads = std::min(threads * 2, options.Threads);
+        }
+    }
+
+    dictionary.Profiling(profiling);
+
+    if (options.Format == Benchmark::Format::CSV) {
+        output = sink.Table(_T("scaling"), "label,threads,ops_per_sec,speedup,acquire_mean_ns,acquire_max_ns,acquire_share,errors");
+    }
+    else if (options.Format == Benchmark::Format::TEXT) {
+        fprintf(output, "Scaling of one shared Dictionary:\n");
+        fprintf(output, "  threads        ops/s  speedup  acquire mean [us]  acquire max [us]  acquire share      errors\n");
+    }
+
+    for (const Step& step : steps) {
+        double speedup = step.Throughput / steps.front().Throughput;
+        uint64_t acquireMean = (step.Acquire.Count == 0 ? 0 : step.Acquire.Total / step.Acquire.Count);
+        double share = (step.Busy == 0 ? 0.0 : static_cast<double>(step.Acquire.Total) / step.Busy);
+
+        switch (options.Format) {
+        case Benchmark::Format::CSV:
+            fprintf(output, "%s/stress,%u,%.0f,%.2f,%llu,%llu,%.4f,%llu\n", options.Label.c_str(), step.Threads, step.Throughput, speedup,
+                static_cast<unsigned long long>(acquireMean), static_cast<unsigned long long>(step.Acquire.Max), share, static_cast<unsigned long long>(step.Failures));
+            break;
+        case Benchmark::Format::JSON:
+            fprintf(output, "{\"label\":\"%s/stress\",\"threads\":%u,\"ops_per_sec\":%.0f,\"speedup\":%.2f,\"acquire_mean_ns\":%llu,\"acquire_max_ns\":%llu,\"acquire_share\":%.4f,\"errors\":%llu}\n",
+                options.Label.c_str(), step.Threads, step.Throughput, speedup,
+                static_cast<unsigned long long>(acquireMean), static_cast<unsigned long long>(step.Acquire.Max), share, static_cast<unsigned long long>(step.Failures));
+            break;
+        default:
+            fprintf(output, "  %7u %12.0f %7.2fx %18.2f %17.2f %13.1f%% %11llu\n", step.Threads, step.Throughput, speedup,
+                acquireMean / 1000.0, step.Acquire.Max / 1000.0, share * 100.0, static_cast<unsigned long long>(step.Failures));
+            break;
+        }
+    }
+
+    return (totalFailures == 0 ? 0 : 1);
+}
+
+// Restarts the Dictionary plugin, through the Controller, over and over while -threads clients
+// keep on calling Get and Set. Per cycle it measures how long the link took to be operational
+// again once the plugin was activated, and how many calls failed in the meantime. Memory is
+// sampled after every cycle, a steady climb points at something that is not cleaned up on a
+// reconnect. Cache and write-behind are off during the run, they would hide the outage.
+int RunReconnect(Dictionary& dictionary, const Core::NodeId& node, const LoadOptions& options)
+{
+    // Time the link gets to settle (and the clients to get some calls through) between restarts.
+    static constexpr uint32_t SettleTime = 500;
+    static constexpr uint32_t StateTimeout = 10000;
+
+    struct Cycle {
+        uint64_t Down; // nanoseconds from Deactivate to Operational(false)
+        uint64_t Recovery; // nanoseconds from Activate to Operational(true)
+        bool Recovered;
+        uint32_t Transitions; // Operational() notifications, a clean restart has one down and one up
+        uint64_t Failed;
+        uint32_t ClientRss;
+        uint32_t ServerRss;
+    };
+
+    Core::ProxyType<RPC::CommunicatorClient> client(Core::ProxyType<RPC::CommunicatorClient>::Create(node));
+    PluginHost::IShell* shell = nullptr;
+
+    if (client->Open(RPC::CommunicationTimeOut) == Core::ERROR_NONE) {
+        // An empty callsign gets us the Controller.
+        PluginHost::IShell* controller = client->Acquire<PluginHost::IShell>(RPC::CommunicationTimeOut, string(), ~0);
+
+        if (controller != nullptr) {
+            shell = controller->QueryInterfaceByCallsign<PluginHost::IShell>(_T("Dictionary"));
+            controller->Release();
+        }
+    }
+
+    if (shell == nullptr) {
+        printf("Could not reach the Dictionary plugin through the Controller, no reconnects\n");
+        client->Close(Core::infinite);
+        return (1);
+    }
+
+    const bool caching = dictionary.Caching();
+    const uint32_t window = dictionary.WriteBehind();
+    const uint32_t clientRss = Platform::ResidentSize(0);
+    const uint32_t serverRss = (options.ServerPid != 0 ? Platform::ResidentSize(options.ServerPid) : 0);
+    std::vector<Cycle> cycles;
+    std::vector<std::thread> workers;
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> calls(0);
+    std::atomic<uint64_t> failures(0);
+
+    dictionary.Caching(false);
+    dictionary.WriteBehind(0, 0);
+    Populate(dictionary, options);
+
+    for (uint32_t thread = 0; thread < options.Threads; thread++) {
+        workers.emplace_back([&, thread]() {
+            std::mt19937 random(thread + 1);
+            std::uniform_int_distribution<uint32_t> keys(0, options.Keys - 1);
+            std::uniform_int_distribution<uint32_t> percentage(0, 99);
+            string value(options.MinValueSize, 'v');
+
+            while (running.load() == true) {
+                string key(Key(keys(random)));
+                bool succeeded = (percentage(random) < options.ReadPercentage ? dictionary.Get(NameSpace(0), key, value) : dictionary.Set(NameSpace(0), key, value));
+
+                calls++;
+                if (succeeded == false) {
+                    failures++;
+                }
             }
-            impl->Release();
-	        printf("Set returned %d\n",result);
+        });
+    }
+
+    uint64_t begin = Benchmark::Now();
+
+    bool active = true;
+
+    for (uint32_t index = 0; (index < options.Cycles) && (active == true); index++) {
+        Cycle cycle;
+        uint64_t failed = failures.load();
+        uint32_t transitions = dictionary.Transitions();
+
+        uint64_t stamp = Benchmark::Now();
+        uint32_t result = shell->Deactivate(PluginHost::IShell::REQUESTED);
+        cycle.Recovered = ((result == Core::ERROR_NONE) && (dictionary.WaitForOperational(false, StateTimeout) == true));
+        cycle.Down = Benchmark::Now() - stamp;
+
+        if (result != Core::ERROR_NONE) {
+            printf("Cycle %4u: Deactivate failed: %s\n", index + 1, Core::ErrorToString(result));
         }
-        else
-        {
-            printf("impl nullptr \n");
+
+        stamp = Benchmark::Now();
+        result = shell->Activate(PluginHost::IShell::REQUESTED);
+        cycle.Recovered = ((result == Core::ERROR_NONE) && (dictionary.WaitForOperational(true, StateTimeout) == true) && (cycle.Recovered == true));
+        cycle.Recovery = Benchmark::Now() - stamp;
+
+        if (result != Core::ERROR_NONE) {
+            // With the plugin down, every further cycle would only measure the same outage.
+            printf("Cycle %4u: Activate failed: %s, stopping\n", index + 1, Core::ErrorToString(result));
+            active = false;
+        }
+        else {
+            SleepMs(SettleTime);
+        }
+
+        // More than one down and one up means the link bounced, fewer that a change went unnoticed.
+        cycle.Transitions = dictionary.Transitions() - transitions;
+        cycle.Recovered = ((cycle.Recovered == true) && (cycle.Transitions == 2));
+        cycle.Failed = failures.load() - failed;
+        cycle.ClientRss = Platform::ResidentSize(0);
+        cycle.ServerRss = (options.ServerPid != 0 ? Platform::ResidentSize(options.ServerPid) : 0);
+        cycles.push_back(cycle);
+
+        if (options.Format == Benchmark::Format::TEXT) {
+            printf("Cycle %4u: down in %8.1f ms, operational in %8.1f ms%s, %u transitions, %8llu calls failed, client RSS %u KB\n",
+                index + 1, cycle.Down / 1000000.0, cycle.Recovery / 1000000.0, (cycle.Recovered ? "" : " (failed)"),
+                cycle.Transitions, static_cast<unsigned long long>(cycle.Failed), cycle.ClientRss);
         }
-        return (result);
     }
 
-    void Trigger()
-    {
-       Exchange::IDictionary* impl = BaseClass::Interface();
-                
-        if (impl != nullptr) {
-            printf("Release 1\n");
-            impl->Release();
-            printf("Release 2\n");
-	    impl->Release();
-        }   
+    uint64_t duration = Benchmark::Now() - begin;
+
+    running = false;
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
 
+    shell->Release();
+    client->Close(Core::infinite);
+
+    dictionary.WriteBehind(window, options.MaxUnflushed);
+    dictionary.Caching(caching);
+
+    Benchmark::Output sink(options.Output);
+    FILE* output = sink.File();
+
+    Benchmark::Result recovery;
+    recovery.Label = options.Label + _T("/recovery");
+    recovery.Threads = options.Threads;
+    recovery.Duration = duration;
+    uint64_t failed = 0;
+    uint64_t maxFailed = 0;
+
+    for (const Cycle& cycle : cycles) {
+        recovery.Samples.Add(cycle.Recovery);
+        recovery.Failures += (cycle.Recovered ? 0 : 1);
+        failed += cycle.Failed;
+        maxFailed = std::max(maxFailed, cycle.Failed);
     }
+    recovery.Calls = recovery.Samples.Count();
 
+    Benchmark::Report(sink, options.Format, recovery);
 
-private:
-    void Operational(const bool upAndRunning) {
-        printf("Operational state of Dictionary: %s\n", upAndRunning ? _T("true") : _T("false"));
+    const Cycle& last(cycles.back());
+    int32_t clientGrowth = static_cast<int32_t>(last.ClientRss) - static_cast<int32_t>(clientRss);
+    int32_t serverGrowth = static_cast<int32_t>(last.ServerRss) - static_cast<int32_t>(serverRss);
+
+    switch (options.Format) {
+    case Benchmark::Format::CSV:
+        fprintf(sink.Table(_T("outage"), "label,cycles,calls,failed_calls,max_failed_per_cycle,client_rss_before_kb,client_rss_after_kb,server_rss_before_kb,server_rss_after_kb"), "%s/outage,%u,%llu,%llu,%llu,%u,%u,%u,%u\n", options.Label.c_str(), options.Cycles,
+            static_cast<unsigned long long>(calls.load()), static_cast<unsigned long long>(failed), static_cast<unsigned long long>(maxFailed),
+            clientRss, last.ClientRss, serverRss, last.ServerRss);
+        break;
+    case Benchmark::Format::JSON:
+        fprintf(output, "{\"label\":\"%s/outage\",\"cycles\":%u,\"calls\":%llu,\"failed_calls\":%llu,\"max_failed_per_cycle\":%llu,"
+                        "\"client_rss_before_kb\":%u,\"client_rss_after_kb\":%u,\"server_rss_before_kb\":%u,\"server_rss_after_kb\":%u}\n",
+            options.Label.c_str(), options.Cycles,
+            static_cast<unsigned long long>(calls.load()), static_cast<unsigned long long>(failed), static_cast<unsigned long long>(maxFailed),
+            clientRss, last.ClientRss, serverRss, last.ServerRss);
+        break;
+    default:
+        fprintf(output, "Outage:       %llu of %llu calls failed, %.0f per cycle on average, %llu at most\n",
+            static_cast<unsigned long long>(failed), static_cast<unsigned long long>(calls.load()),
+            static_cast<double>(failed) / options.Cycles, static_cast<unsigned long long>(maxFailed));
+        fprintf(output, "Client RSS:   %u KB before, %u KB after (%+d KB, %+.1f KB per cycle)\n", clientRss, last.ClientRss, clientGrowth, static_cast<double>(clientGrowth) / options.Cycles);
+        if (options.ServerPid != 0) {
+            fprintf(output, "Server RSS:   %u KB before, %u KB after (%+d KB, %+.1f KB per cycle)\n", serverRss, last.ServerRss, serverGrowth, static_cast<double>(serverGrowth) / options.Cycles);
+        }
+        break;
     }
-};
 
+    return (recovery.Failures == 0 ? 0 : 1);
+}
+
+// Exports a namespace, and all below it, as "<namespace>\t<key>\t<value>" lines to -export (or
+// the console), a page at a time. The time taken per page is reported like any other run.
+int RunScan(Dictionary& dictionary, const LoadOptions& options)
+{
+    Dictionary::Scanner scanner(dictionary, options.Scan, options.PageSize);
+    std::vector<Dictionary::Entry> page;
+    uint64_t entries = 0;
+    uint64_t missing = 0;
+    FILE* exported = stdout;
+
+    if ((options.Export.empty() == false) && ((exported = fopen(options.Export.c_str(), "w")) == nullptr)) {
+        fprintf(stderr, "Could not open %s, exporting to the console\n", options.Export.c_str());
+        exported = stdout;
+    }
+
+    Benchmark::Result report;
+    report.Label = options.Label + _T("/scan");
+    report.Threads = 1;
+
+    page.reserve(options.PageSize);
+
+    uint64_t begin = Benchmark::Now();
+    uint64_t stamp = begin;
+
+    while (scanner.Next(page) == true) {
+        report.Samples.Add(Benchmark::Now() - stamp);
+
+        for (const Dictionary::Entry& entry : page) {
+            if (entry.Valid == true) {
+                fprintf(exported, "%s\t%s\t%s\n", entry.NameSpace.c_str(), entry.Key.c_str(), entry.Value.c_str());
+            }
+            else {
+                // Removed (or unreachable) between listing the key and reading its value.
+                missing++;
+            }
+        }
+        entries += page.size();
+
+        stamp = Benchmark::Now();
+    }
+
+    report.Duration = Benchmark::Now() - begin;
+    report.Calls = report.Samples.Count();
+    report.Failures = missing + (scanner.Failed() ? 1 : 0);
+
+    if (exported != stdout) {
+        fclose(exported);
+    }
+
+    Benchmark::Output sink(options.Output);
+
+    Benchmark::Report(sink, options.Format, report);
+
+    if (options.Format == Benchmark::Format::TEXT) {
+        fprintf(sink.File(), "Scanned:      %s, %llu entries (%llu without value) in pages of at most %u, %.0f entries/s%s\n",
+            options.Scan.c_str(), static_cast<unsigned long long>(entries), static_cast<unsigned long long>(missing), options.PageSize,
+            entries / (report.Duration / 1000000000.0), (scanner.Failed() ? _T(", stopped early") : _T("")));
+    }
+
+    return (((scanner.Failed() == false) && (missing == 0)) ? 0 : 1);
+}
+
+// Set/Get pairs of one key for value sizes from 16 bytes up to 1 MB, with the value handled in
+// two ways: a fresh string per call and the caller reusing its strings. The wire transfer and the
+// proxy copies are the same for both, the difference is in the allocations on the client side.
+int RunValues(Dictionary& dictionary, const LoadOptions& options)
+{
+    enum mode : uint8_t {
+        FRESH,
+        REUSED,
+        MODES
+    };
+
+    static const TCHAR* modes[MODES] = { _T("fresh"), _T("reused") };
+    static constexpr uint32_t MaxSize = 1024 * 1024;
+
+    const bool caching = dictionary.Caching();
+    const uint32_t window = dictionary.WriteBehind();
+    std::vector<uint8_t> payload(MaxSize);
+    uint64_t totalFailures = 0;
+    Benchmark::Output sink(options.Output);
+    FILE* output = sink.File();
+
+    for (uint32_t index = 0; index < MaxSize; index++) {
+        payload[index] = static_cast<uint8_t>('a' + (index % 26));
+    }
+
+    // Both would keep the value on the client side, here it should cross every time.
+    dictionary.Caching(false);
+    dictionary.WriteBehind(0, 0);
+
+    for (uint32_t size = 16; size <= MaxSize; size *= 4) {
+        for (uint8_t mode = 0; mode < MODES; mode++) {
+            Benchmark::Result report;
+            report.Label = options.Label + _T("/values/") + Core::NumberType<uint32_t>(size).Text() + '/' + modes[mode];
+            report.Threads = 1;
+            report.Samples.Reserve(options.Operations);
+
+            string value;
+            string result;
+            uint64_t begin = Benchmark::Now();
+
+            for (uint32_t operation = 0; operation < options.Operations; operation++) {
+                uint64_t stamp = Benchmark::Now();
+                bool succeeded = false;
+
+                switch (mode) {
+                case FRESH: {
+                    string fresh(reinterpret_cast<const char*>(payload.data()), size);
+                    string answer;
+                    succeeded = ((dictionary.Set(_T("/values"), _T("key"), fresh) == true) && (dictionary.Get(_T("/values"), _T("key"), answer) == true) && (answer.size() == size));
+                    break;
+                }
+                default:
+                    value.assign(reinterpret_cast<const char*>(payload.data()), size);
+                    succeeded = ((dictionary.Set(_T("/values"), _T("key"), value) == true) && (dictionary.Get(_T("/values"), _T("key"), result) == true) && (result.size() == size));
+                    break;
+                }
+
+                report.Samples.Add(Benchmark::Now() - stamp);
+                report.Failures += (succeeded ? 0 : 1);
+            }
+
+            report.Duration = Benchmark::Now() - begin;
+            report.Calls = report.Samples.Count();
+            totalFailures += report.Failures;
+
+            Benchmark::Report(sink, options.Format, report);
+
+            if (options.Format == Benchmark::Format::TEXT) {
+                fprintf(output, "Transfer:     %.1f MB/s (Set and Get)\n", (2.0 * size * report.Calls) / (report.Duration / 1000.0));
+            }
+        }
+    }
+
+    dictionary.WriteBehind(window, options.MaxUnflushed);
+    dictionary.Caching(caching);
+
+    return (totalFailures == 0 ? 0 : 1);
+}
+
+// All threads Get the same key, once taking the interface for every call and once through the
+// pinned interface. The remote side is identical in both runs, so the difference between them
+// is what taking and releasing the interface costs, contention on its lock included.
+int RunOverhead(Dictionary& dictionary, const LoadOptions& options)
+{
+    static const TCHAR* modes[] = { _T("/refcounted"), _T("/pinned") };
+
+    const bool caching = dictionary.Caching();
+    const bool pinning = dictionary.Pinning();
+    uint64_t totalFailures = 0;
+    Benchmark::Output sink(options.Output);
+
+    // Cache hits never reach the interface, so they would hide exactly what is measured here.
+    dictionary.Caching(false);
+    dictionary.Set(_T("/overhead"), _T("key"), string(options.MinValueSize, 'v'));
+
+    for (uint8_t mode = 0; mode < 2; mode++) {
+        std::vector<Benchmark::Latencies> gets(options.Threads);
+        std::vector<uint64_t> failures(options.Threads, 0);
+        std::vector<std::thread> workers;
+        std::atomic<bool> start(false);
+
+        dictionary.Pinning(mode == 1);
+
+        for (uint32_t thread = 0; thread < options.Threads; thread++) {
+            workers.emplace_back([&, thread]() {
+                string value;
+
+                gets[thread].Reserve(options.Operations);
+
+                while (start.load() == false) {
+                    std::this_thread::yield();
+                }
+
+                for (uint32_t operation = 0; operation < options.Operations; operation++) {
+                    uint64_t begin = Benchmark::Now();
+                    if (dictionary.Get(_T("/overhead"), _T("key"), value) == false) {
+                        failures[thread]++;
+                    }
+                    gets[thread].Add(Benchmark::Now() - begin);
+                }
+            });
+        }
+
+        uint64_t begin = Benchmark::Now();
+        start = true;
 
-int main(int /* argc */, char** /* argv */)
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        Benchmark::Result report;
+        report.Label = options.Label + modes[mode];
+        report.Threads = options.Threads;
+        report.Duration = Benchmark::Now() - begin;
+
+        for (uint32_t thread = 0; thread < options.Threads; thread++) {
+            report.Samples.Merge(gets[thread]);
+            report.Failures += failures[thread];
+        }
+        report.Calls = report.Samples.Count();
+        totalFailures += report.Failures;
+
+        Benchmark::Report(sink, options.Format, report);
+    }
+
+    dictionary.Pinning(pinning);
+    dictionary.Caching(caching);
+
+    return (totalFailures == 0 ? 0 : 1);
+}
+
+int main(int argc, char** argv)
 {
+        LoadOptions load;
+        int exitCode = 0;
+
         std::cout << "TestClient" <<std::endl;
 
+        if (ParseOptions(argc, argv, load) == true) {
+            printf("Options:\n");
+            printf("-load <operations> [non-interactive, every thread performs <operations> Get/Set calls]\n");
+            printf("-overhead <operations> [non-interactive, compare Gets with and without a pinned interface]\n");
+            printf("-stress <operations> [non-interactive, repeat the load with 1, 2, 4, ... up to -threads threads]\n");
+            printf("-values <operations> [non-interactive, Set/Get pairs for value sizes from 16 bytes to 1 MB]\n");
+            printf("-scan <namespace> [non-interactive, export the namespace and all below it to -export]\n");
+            printf("-export <file> [file -scan exports to, overwritten, default: console]\n");
+            printf("-page <entries> [entries fetched per page by -scan, default: 256]\n");
+            printf("-reconnect <cycles> [non-interactive, restart the Dictionary plugin while -threads clients keep calling]\n");
+            printf("-pid <pid> [process id hosting the Dictionary, to track its memory usage over the reconnects]\n");
+            printf("-threads <count> [number of load threads, default: 1]\n");
+            printf("-keys <count> [number of keys per namespace, default: 1000]\n");
+            printf("-namespaces <count> [number of namespaces, default: 1]\n");
+            printf("-value <size>|<min>:<max> [size of the values written, default: 8:64]\n");
+            printf("-reads <percentage> [share of Get calls, default: 80]\n");
+            printf("-cache <on|off> [serve repeated Gets from a local cache, default: off]\n");
+            printf("-writebehind <ms>[:<bytes>] [coalesce Sets for <ms>, flush earlier at <bytes> waiting, default: 0 (off):1048576]\n");
+            printf("-pin <on|off> [hold on to the interface while it is operational, default: off]\n");
+            printf("-trace <file> [write a Chrome trace of the calls of the non-interactive run to <file>]\n");
+            printf("-format <text|csv|json> [report format, default: text]\n");
+            printf("-output <file> [append the report to this file, CSV tables other than the report go next to it as <file>.<table>, default: console]\n");
+            printf("-label <name> [tag for the report]\n");
+            Core::Singleton::Dispose();
+            return (0);
+        }
 
         Core::NodeId nodeId("/tmp/communicator");
        {
@@ -115,8 +888,47 @@ int main(int /* argc */, char** /* argv */)
         char keyPress;
         uint32_t counter = 8;
 
-        std::cout << "Looping to get options" <<std::endl;
-        do {
+        dictionary.Caching(load.Cache);
+        dictionary.Pinning(load.Pin);
+        dictionary.WriteBehind(load.Window, load.MaxUnflushed);
+        dictionary.Tracing(load.Trace.empty() == false);
+
+        if ((load.Enabled == true) || (load.Overhead == true) || (load.Stress == true) || (load.Values == true) || (load.Scan.empty() == false) || (load.Cycles != 0)) {
+            if (dictionary.IsOperational() == false) {
+                printf("The Dictionary is not available, no load generated\n");
+                exitCode = 1;
+            }
+            else if (load.Overhead == true) {
+                exitCode = RunOverhead(dictionary, load);
+            }
+            else if (load.Stress == true) {
+                exitCode = RunStress(dictionary, load);
+            }
+            else if (load.Values == true) {
+                exitCode = RunValues(dictionary, load);
+            }
+            else if (load.Scan.empty() == false) {
+                exitCode = RunScan(dictionary, load);
+            }
+            else if (load.Cycles != 0) {
+                exitCode = RunReconnect(dictionary, nodeId, load);
+            }
+            else {
+                exitCode = RunLoad(dictionary, load);
+            }
+
+            if (load.Trace.empty() == false) {
+                dictionary.Tracing(false);
+                printf("Traced %u of %llu calls to %s\n", dictionary.DumpTrace(load.Trace), static_cast<unsigned long long>(dictionary.TraceRecorded()), load.Trace.c_str());
+            }
+            keyPress = 'Q';
+        }
+        else {
+            std::cout << "Looping to get options" <<std::endl;
+            keyPress = 0;
+        }
+
+        while (keyPress != 'Q') {
             keyPress = toupper(getchar());
             
             switch (keyPress) {
@@ -146,18 +958,83 @@ int main(int /* argc */, char** /* argv */)
 
             }
             case 'X': {
+                // Only report progress now and then, printing every iteration measures the console.
                 uint32_t count = 0;
+                uint32_t failures = 0;
+                uint64_t begin = Benchmark::Now();
                 while (count++ != 500000) {
                     string value = Core::NumberType<int32_t>(counter++).Text();
-                    if (dictionary.Set(_T("/name"), _T("key"), value) == true) {
-                        if (dictionary.Get(_T("/name"), _T("key"), value) == true) {
-                            printf("Iteration %6i: Set/Get value: %s\n", count, value.c_str());
-                        }
+                    if ((dictionary.Set(_T("/name"), _T("key"), value) == false) || (dictionary.Get(_T("/name"), _T("key"), value) == false)) {
+                        failures++;
+                    }
+                    if ((count % 50000) == 0) {
+                        printf("Iteration %6i: Set/Get value: %s\n", count, value.c_str());
                     }
                 }
+                failures += dictionary.Flush();
+                uint64_t duration = Benchmark::Now() - begin;
+                printf("500000 Set/Get pairs in %.3f s (%.0f pairs/s), %u failed\n", duration / 1000000000.0, 500000 / (duration / 1000000000.0), failures);
                 break;
 
             }
+            case 'M': {
+                std::vector<Dictionary::Entry> entries;
+                for (uint32_t index = 0; index < 10; index++) {
+                    entries.emplace_back(_T("/name"), Key(index), Core::NumberType<int32_t>(counter++).Text());
+                }
+                printf("SetMany: %u of %u succeeded\n", dictionary.SetMany(entries), static_cast<uint32_t>(entries.size()));
+
+                for (Dictionary::Entry& entry : entries) {
+                    entry.Value.clear();
+                }
+                printf("GetMany: %u of %u succeeded\n", dictionary.GetMany(entries), static_cast<uint32_t>(entries.size()));
+                for (const Dictionary::Entry& entry : entries) {
+                    printf("  %s/%s: %s\n", entry.NameSpace.c_str(), entry.Key.c_str(), (entry.Valid ? entry.Value.c_str() : _T("<failed>")));
+                }
+                break;
+            }
+            case 'C': {
+                dictionary.Caching(!dictionary.Caching());
+                Dictionary::CacheStatistics cache(dictionary.Statistics());
+                printf("Caching %s: %llu hits, %llu misses, %llu invalidations, %u entries\n",
+                    (dictionary.Caching() ? _T("enabled") : _T("disabled")),
+                    static_cast<unsigned long long>(cache.Hits), static_cast<unsigned long long>(cache.Misses),
+                    static_cast<unsigned long long>(cache.Invalidations), cache.Entries);
+                break;
+            }
+            case 'P': {
+                dictionary.Pinning(!dictionary.Pinning());
+                printf("Pinning %s\n", (dictionary.Pinning() ? _T("enabled") : _T("disabled")));
+                break;
+            }
+            case 'W': {
+                dictionary.WriteBehind((dictionary.WriteBehind() == 0 ? 10 : 0), load.MaxUnflushed);
+                printf("Write-behind %s\n", (dictionary.WriteBehind() != 0 ? _T("enabled, 10 ms window") : _T("disabled")));
+                ReportWrites(stdout, dictionary);
+                break;
+            }
+            case 'E': {
+                Dictionary::Scanner scanner(dictionary, _T("/name"), 16);
+                std::vector<Dictionary::Entry> page;
+                while (scanner.Next(page) == true) {
+                    for (const Dictionary::Entry& entry : page) {
+                        printf("  %s/%s: %s\n", entry.NameSpace.c_str(), entry.Key.c_str(), (entry.Valid ? entry.Value.c_str() : _T("<failed>")));
+                    }
+                }
+                break;
+            }
+            case 'D': {
+                // First press starts tracing, the second one writes what was recorded.
+                if (dictionary.Tracing() == false) {
+                    dictionary.Tracing(true);
+                    printf("Tracing started\n");
+                }
+                else {
+                    dictionary.Tracing(false);
+                    printf("Traced %u of %llu calls to /tmp/TestClient.trace.json\n", dictionary.DumpTrace(_T("/tmp/TestClient.trace.json")), static_cast<unsigned long long>(dictionary.TraceRecorded()));
+                }
+                break;
+            }
             case 'T': {
                std::cout << "Triggering" << std::endl;
                dictionary.Trigger();
@@ -166,11 +1043,11 @@ int main(int /* argc */, char** /* argv */)
             case 'Q': break;
             default: break;
             };
-        } while (keyPress != 'Q');
+        }
      }
     printf("Prior to the call Dispose\n");
     Core::Singleton::Dispose();
     printf("Completed the call Dispose\n");
 
-    return 0;
+    return (exitCode);
 }
@@ -0,0 +1,170 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace WPEFramework {
+
+namespace Client {
+
+    // Invoke blocks until its answer is in, Dispatch only sends the request: the link gives every
+    // request an id of its own and hands the answer to the callback whenever it arrives, in any
+    // order. AsyncTime uses that to keep as many "time" calls in flight over one link as wanted,
+    // completed through a callback or a future. Callbacks run on the thread of the link that
+    // received the answer, keep them short.
+    class AsyncTime {
+    public:
+        struct Result {
+            Result()
+                : Error(Core::ERROR_UNAVAILABLE)
+                , Time()
+            {
+            }
+
+            uint32_t Error;
+            string Time;
+        };
+
+        using Callback = std::function<void(const uint32_t error, const string& time)>;
+
+    public:
+        AsyncTime() = delete;
+        AsyncTime(const AsyncTime&) = delete;
+        AsyncTime& operator=(const AsyncTime&) = delete;
+
+        AsyncTime(JSONRPC::LinkType<Core::JSON::IElement>& link, const uint32_t waitTime)
+            : _link(link)
+            , _waitTime(waitTime)
+            , _lock()
+            , _signal()
+            , _pending(0)
+        {
+        }
+        // Every request gets its answer or times out, so this never waits longer than the time out.
+        ~AsyncTime()
+        {
+            Drain(Core::infinite);
+        }
+
+    public:
+        void Time(const Callback& completed)
+        {
+            {
+                std::unique_lock<std::mutex> guard(_lock);
+                _pending++;
+            }
+
+            uint32_t result = _link.Dispatch<void>(_waitTime, _T("time"), [this, completed](const Core::JSON::String& response, const Core::JSONRPC::Error* error) {
+                completed((error == nullptr ? Core::ERROR_NONE : static_cast<uint32_t>(error->Code.Value())), response.Value());
+                Completed();
+            });
+
+            // Not sent, so the callback will never come.
+            if (result != Core::ERROR_NONE) {
+                completed(result, string());
+                Completed();
+            }
+        }
+        std::future<Result> Time()
+        {
+            std::shared_ptr<std::promise<Result>> promise(std::make_shared<std::promise<Result>>());
+
+            Time([promise](const uint32_t error, const string& time) {
+                Result result;
+                result.Error = error;
+                result.Time = time;
+                promise->set_value(result);
+            });
+
+            return (promise->get_future());
+        }
+        // No batch framing: Thunder takes one request per frame and has no JSON-RPC array batches.
+        // This sends <results.size()> requests back to back, each in its own frame, without
+        // waiting for any answer in between, and returns once all are answered with the number
+        // of calls that failed.
+        uint32_t Batch(std::vector<Result>& results)
+        {
+            struct State {
+                std::mutex Lock;
+                std::condition_variable Done;
+                uint32_t Remaining;
+                uint32_t Failed;
+            };
+
+            std::shared_ptr<State> state(std::make_shared<State>());
+            state->Remaining = static_cast<uint32_t>(results.size());
+            state->Failed = 0;
+
+            for (uint32_t index = 0; index < results.size(); index++) {
+                Result& result(results[index]);
+
+                Time([state, &result](const uint32_t error, const string& time) {
+                    std::unique_lock<std::mutex> guard(state->Lock);
+                    result.Error = error;
+                    result.Time = time;
+                    state->Failed += (error == Core::ERROR_NONE ? 0 : 1);
+                    state->Remaining--;
+                    state->Done.notify_one();
+                });
+            }
+
+            std::unique_lock<std::mutex> guard(state->Lock);
+            state->Done.wait(guard, [&state]() { return (state->Remaining == 0); });
+
+            return (state->Failed);
+        }
+        // Waits until no more calls are in flight, returns false if they were not all in on time.
+        bool Drain(const uint32_t waitTime)
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+
+            if (waitTime == Core::infinite) {
+                _signal.wait(guard, [this]() { return (_pending == 0); });
+                return (true);
+            }
+
+            return (_signal.wait_for(guard, std::chrono::milliseconds(waitTime), [this]() { return (_pending == 0); }));
+        }
+
+    private:
+        void Completed()
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+            _pending--;
+            _signal.notify_all();
+        }
+
+    private:
+        JSONRPC::LinkType<Core::JSON::IElement>& _link;
+        const uint32_t _waitTime;
+        std::mutex _lock;
+        std::condition_variable _signal;
+        uint32_t _pending;
+    };
+}
+}
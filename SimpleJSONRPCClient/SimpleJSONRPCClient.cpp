@@ -24,10 +24,52 @@
 #endif
 
 #include "../JSONRPCPlugin/Data.h"
+#include "../TrivialCOMRPC/client/Statistics.h"
+#include "AsyncTime.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 using namespace WPEFramework;
 
-bool ParseOptions(int argc, char** argv, uint32_t& limit, uint32_t& delayMs, uint32_t& justDelay)
+struct LoadOptions {
+    LoadOptions()
+        : Duration(0)
+        , Threads(1)
+        , Links(1)
+        , Rate(0)
+        , Depth(0)
+        , Batch(0)
+        , Events(0)
+        , Event(_T("tick"))
+        , Timeout(1000)
+        , Format(Thunder::Benchmark::Format::TEXT)
+        , Output()
+        , Label(_T("SimpleJSONRPCClient"))
+    {
+    }
+
+    uint32_t Duration; // seconds, 0 is no load run
+    uint32_t Threads;
+    uint32_t Links;
+    uint32_t Rate; // requests per second over all threads, 0 is closed loop
+    uint32_t Depth; // requests kept in flight per thread, 0 is blocking Invoke
+    uint16_t Batch; // calls per batch, 0 is no batch comparison
+    uint32_t Events; // seconds to receive events, 0 is no event run
+    string Event;
+    uint32_t Timeout; // ms
+    Thunder::Benchmark::Format Format;
+    string Output;
+    string Label;
+};
+
+bool ParseOptions(int argc, char** argv, uint32_t& limit, uint32_t& delayMs, uint32_t& justDelay, LoadOptions& load)
 {
     int index = 1;
     limit = 10;
@@ -44,6 +86,42 @@ bool ParseOptions(int argc, char** argv, uint32_t& limit, uint32_t& delayMs, uin
         }else if (strcmp(argv[index], "-j") == 0) {
             justDelay = atoi(argv[index + 1]);
             index++;
+        } else if ((strcmp(argv[index], "-load") == 0) && ((index + 1) < argc)) {
+            load.Duration = std::max(atoi(argv[index + 1]), 1);
+            index++;
+        } else if ((strcmp(argv[index], "-threads") == 0) && ((index + 1) < argc)) {
+            load.Threads = std::max(atoi(argv[index + 1]), 1);
+            index++;
+        } else if ((strcmp(argv[index], "-links") == 0) && ((index + 1) < argc)) {
+            load.Links = std::max(atoi(argv[index + 1]), 1);
+            index++;
+        } else if ((strcmp(argv[index], "-rate") == 0) && ((index + 1) < argc)) {
+            load.Rate = atoi(argv[index + 1]);
+            index++;
+        } else if ((strcmp(argv[index], "-async") == 0) && ((index + 1) < argc)) {
+            load.Depth = atoi(argv[index + 1]);
+            index++;
+        } else if ((strcmp(argv[index], "-batch") == 0) && ((index + 1) < argc)) {
+            load.Batch = static_cast<uint16_t>(std::min(std::max(atoi(argv[index + 1]), 1), 0xFFFF));
+            index++;
+        } else if ((strcmp(argv[index], "-events") == 0) && ((index + 1) < argc)) {
+            load.Events = std::max(atoi(argv[index + 1]), 1);
+            index++;
+        } else if ((strcmp(argv[index], "-event") == 0) && ((index + 1) < argc)) {
+            load.Event = argv[index + 1];
+            index++;
+        } else if ((strcmp(argv[index], "-timeout") == 0) && ((index + 1) < argc)) {
+            load.Timeout = std::max(atoi(argv[index + 1]), 1);
+            index++;
+        } else if ((strcmp(argv[index], "-format") == 0) && ((index + 1) < argc)) {
+            showHelp = (Thunder::Benchmark::ParseFormat(argv[index + 1], load.Format) == false);
+            index++;
+        } else if ((strcmp(argv[index], "-output") == 0) && ((index + 1) < argc)) {
+            load.Output = argv[index + 1];
+            index++;
+        } else if ((strcmp(argv[index], "-label") == 0) && ((index + 1) < argc)) {
+            load.Label = argv[index + 1];
+            index++;
         } else if (strcmp(argv[index], "-h") == 0) {
             showHelp = true;
         }
@@ -53,11 +131,462 @@ bool ParseOptions(int argc, char** argv, uint32_t& limit, uint32_t& delayMs, uin
     return (showHelp);
 }
 
+// Every link gets a connection of its own: links to the same callsign with the same query share
+// one channel, so the query is what keeps them apart.
+std::unique_ptr<JSONRPC::LinkType<Core::JSON::IElement>> CreateLink(const uint32_t index)
+{
+    string events(_T("client.events.") + Core::NumberType<uint32_t>(index + 1).Text());
+    string query(_T("link=") + Core::NumberType<uint32_t>(index + 1).Text());
+
+    return (std::unique_ptr<JSONRPC::LinkType<Core::JSON::IElement>>(new JSONRPC::LinkType<Core::JSON::IElement>(_T("JSONRPCPlugin.1"), events.c_str(), false, query)));
+}
+
+// Calls "time" for <duration> seconds from <threads> threads over <links> links. Closed loop (no
+// -rate) every thread calls again as soon as the previous answer is in. Open loop every thread
+// sends at its share of -rate: the calls are synchronous, so a thread that falls behind sends the
+// next call right away, but its latency is measured from the moment it should have been sent,
+// so a saturated gateway shows up in the latencies instead of being hidden by the slower pace.
+// With -async the calls are dispatched instead, every thread keeps up to <depth> of them in flight
+// and only waits when that many are still unanswered.
+int RunLoad(const LoadOptions& options)
+{
+    std::vector<std::unique_ptr<JSONRPC::LinkType<Core::JSON::IElement>>> links;
+    std::vector<Thunder::Benchmark::Latencies> samples(options.Threads);
+    std::vector<uint64_t> timeouts(options.Threads, 0);
+    std::vector<uint64_t> errors(options.Threads, 0);
+    std::vector<std::thread> workers;
+    std::atomic<bool> start(false);
+
+    for (uint32_t index = 0; index < options.Links; index++) {
+        links.emplace_back(CreateLink(index));
+    }
+
+    const uint64_t end = static_cast<uint64_t>(options.Duration) * 1000000000ULL;
+    const uint64_t interval = (options.Rate == 0 ? 0 : (1000000000ULL * options.Threads) / options.Rate);
+
+    for (uint32_t thread = 0; thread < options.Threads; thread++) {
+        workers.emplace_back([&, thread]() {
+            // With more links than threads a thread cycles over its own links, with fewer the
+            // threads share them.
+            std::vector<JSONRPC::LinkType<Core::JSON::IElement>*> mine;
+            for (uint32_t index = (options.Links > options.Threads ? thread : (thread % options.Links)); index < options.Links; index += options.Threads) {
+                mine.push_back(links[index].get());
+            }
+
+            std::vector<std::unique_ptr<Client::AsyncTime>> pipelines;
+            for (JSONRPC::LinkType<Core::JSON::IElement>* link : mine) {
+                pipelines.emplace_back(options.Depth == 0 ? nullptr : new Client::AsyncTime(*link, options.Timeout));
+            }
+
+            // Answers to dispatched calls come in on the link threads, hence the lock.
+            std::mutex lock;
+            std::condition_variable answered;
+            uint32_t inFlight = 0;
+
+            Core::JSON::String result;
+            uint32_t next = 0;
+
+            while (start.load() == false) {
+                std::this_thread::yield();
+            }
+
+            uint64_t begin = Thunder::Benchmark::Now();
+            // Spread the threads over the interval, instead of having them all send at once.
+            uint64_t scheduled = (interval * thread) / options.Threads;
+
+            while ((Thunder::Benchmark::Now() - begin) < end) {
+                if (interval != 0) {
+                    uint64_t now = Thunder::Benchmark::Now() - begin;
+                    if (now < scheduled) {
+                        std::this_thread::sleep_for(std::chrono::nanoseconds(scheduled - now));
+                    }
+                }
+
+                if (options.Depth == 0) {
+                    uint64_t sent = (interval != 0 ? begin + scheduled : Thunder::Benchmark::Now());
+                    uint32_t error = mine[next]->Invoke<void, Core::JSON::String>(options.Timeout, _T("time"), result);
+                    samples[thread].Add(Thunder::Benchmark::Now() - sent);
+
+                    if (error == Core::ERROR_TIMEDOUT) {
+                        timeouts[thread]++;
+                    } else if (error != Core::ERROR_NONE) {
+                        errors[thread]++;
+                    }
+                } else {
+                    std::unique_lock<std::mutex> guard(lock);
+                    answered.wait(guard, [&]() { return (inFlight < options.Depth); });
+                    inFlight++;
+                    guard.unlock();
+
+                    uint64_t sent = (interval != 0 ? begin + scheduled : Thunder::Benchmark::Now());
+
+                    pipelines[next]->Time([&, sent](const uint32_t error, const string&) {
+                        uint64_t now = Thunder::Benchmark::Now();
+                        std::unique_lock<std::mutex> guard(lock);
+
+                        samples[thread].Add(now - sent);
+                        if (error == Core::ERROR_TIMEDOUT) {
+                            timeouts[thread]++;
+                        } else if (error != Core::ERROR_NONE) {
+                            errors[thread]++;
+                        }
+                        inFlight--;
+                        answered.notify_one();
+                    });
+                }
+
+                next = (next + 1) % mine.size();
+                scheduled += interval;
+            }
+
+            // Destructing the pipelines waits for the calls that are still out.
+            pipelines.clear();
+        });
+    }
+
+    uint64_t begin = Thunder::Benchmark::Now();
+    start = true;
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    Thunder::Benchmark::Result report;
+    report.Label = options.Label + _T("/time");
+    report.Threads = options.Threads;
+    report.Depth = options.Depth;
+    report.Duration = Thunder::Benchmark::Now() - begin;
+
+    uint64_t totalTimeouts = 0;
+    uint64_t totalErrors = 0;
+
+    for (uint32_t thread = 0; thread < options.Threads; thread++) {
+        report.Samples.Merge(samples[thread]);
+        totalTimeouts += timeouts[thread];
+        totalErrors += errors[thread];
+    }
+    report.Calls = report.Samples.Count();
+    report.Failures = totalTimeouts + totalErrors;
+
+    links.clear();
+
+    Thunder::Benchmark::Output sink(options.Output);
+    FILE* output = sink.File();
+
+    Thunder::Benchmark::Report(sink, options.Format, report);
+
+    double achieved = report.Calls / (report.Duration / 1000000000.0);
+
+    switch (options.Format) {
+    case Thunder::Benchmark::Format::CSV:
+        fprintf(sink.Table(_T("gateway"), "label,links,target_rps,achieved_rps,timeouts,errors"), "%s/gateway,%u,%u,%.0f,%llu,%llu\n", options.Label.c_str(), options.Links, options.Rate, achieved,
+            static_cast<unsigned long long>(totalTimeouts), static_cast<unsigned long long>(totalErrors));
+        break;
+    case Thunder::Benchmark::Format::JSON:
+        fprintf(output, "{\"label\":\"%s/gateway\",\"links\":%u,\"target_rps\":%u,\"achieved_rps\":%.0f,\"timeouts\":%llu,\"errors\":%llu}\n",
+            options.Label.c_str(), options.Links, options.Rate, achieved,
+            static_cast<unsigned long long>(totalTimeouts), static_cast<unsigned long long>(totalErrors));
+        break;
+    default:
+        fprintf(output, "Gateway:      %.0f requests/s over %u link(s), target %s, %llu timed out (> %u ms), %llu other errors\n",
+            achieved, options.Links, (options.Rate == 0 ? _T("closed loop") : (Core::NumberType<uint32_t>(options.Rate).Text() + _T(" requests/s")).c_str()),
+            static_cast<unsigned long long>(totalTimeouts), options.Timeout, static_cast<unsigned long long>(totalErrors));
+        break;
+    }
+
+    return (report.Failures == 0 ? 0 : 1);
+}
+
+void RunTime(const uint32_t limit, const uint32_t delay, const uint32_t justDelay)
+{
+    JSONRPC::LinkType<Core::JSON::IElement> remoteObject(_T("JSONRPCPlugin.1"), _T("client.events.1"));
+
+    if(justDelay != 0)
+    {
+        Core::JSON::String result;
+        remoteObject.Invoke<void, Core::JSON::String>(1000, _T("time"), result);
+        printf("received time: %s\n", result.Value().c_str());
+        SleepMs(justDelay);
+    } else {
+        for (int i = 0; i < limit; ++i)
+        {
+            Core::JSON::String result;
+            remoteObject.Invoke<void, Core::JSON::String>(1000, _T("time"), result);
+            printf("received time: %s\n", result.Value().c_str());
+            SleepMs(delay);
+        }
+    }
+}
+
+// Process CPU time in nanoseconds, all threads (so also those of the link) included.
+uint64_t ProcessTime()
+{
+    return (static_cast<uint64_t>(std::clock()) * (1000000000ULL / CLOCKS_PER_SEC));
+}
+
+// First calls "time" one at a time for <duration>, then in batches of -batch calls for as long,
+// over the same link. There is no batch framing: every call in a batch is still a frame of its
+// own, the batch only stops waiting for each answer before sending the next request. What that
+// saves, the round trip and the wake ups per call, shows in calls/s and CPU time per call.
+int RunBatch(const LoadOptions& options)
+{
+    const uint64_t duration = static_cast<uint64_t>(options.Duration == 0 ? 5 : options.Duration) * 1000000000ULL;
+
+    JSONRPC::LinkType<Core::JSON::IElement> remoteObject(_T("JSONRPCPlugin.1"), _T("client.events.1"));
+    Client::AsyncTime pipeline(remoteObject, options.Timeout);
+    std::vector<Client::AsyncTime::Result> results(options.Batch);
+    Thunder::Benchmark::Result reports[2];
+    uint64_t cpu[2];
+    reports[0].Label = options.Label + _T("/single");
+    reports[1].Label = options.Label + _T("/batch") + Core::NumberType<uint16_t>(options.Batch).Text();
+    const uint16_t batch[2] = { 1, options.Batch };
+
+    for (uint8_t run = 0; run < 2; run++) {
+        Thunder::Benchmark::Result& report(reports[run]);
+        Core::JSON::String result;
+        uint64_t started = ProcessTime();
+        uint64_t begin = Thunder::Benchmark::Now();
+
+        report.Threads = 1;
+
+        while ((Thunder::Benchmark::Now() - begin) < duration) {
+            uint64_t stamp = Thunder::Benchmark::Now();
+
+            if (run == 0) {
+                report.Failures += (remoteObject.Invoke<void, Core::JSON::String>(options.Timeout, _T("time"), result) == Core::ERROR_NONE ? 0 : 1);
+                report.Calls++;
+            } else {
+                report.Failures += pipeline.Batch(results);
+                report.Calls += options.Batch;
+            }
+
+            // For batches this is the latency of the batch as a whole.
+            report.Samples.Add(Thunder::Benchmark::Now() - stamp);
+        }
+
+        report.Duration = Thunder::Benchmark::Now() - begin;
+        cpu[run] = ProcessTime() - started;
+    }
+
+    Thunder::Benchmark::Output sink(options.Output);
+    FILE* output = sink.File();
+
+    if (options.Format == Thunder::Benchmark::Format::CSV) {
+        output = sink.Table(_T("batch"), "label,batch,calls,calls_per_sec,cpu_ns_per_call");
+    }
+
+    for (uint8_t run = 0; run < 2; run++) {
+        const Thunder::Benchmark::Result& report(reports[run]);
+        double rate = (report.Duration == 0 ? 0.0 : report.Calls / (report.Duration / 1000000000.0));
+        double perCall = (report.Calls == 0 ? 0.0 : static_cast<double>(cpu[run]) / report.Calls);
+
+        switch (options.Format) {
+        case Thunder::Benchmark::Format::CSV:
+            fprintf(output, "%s,%u,%llu,%.0f,%.0f\n", report.Label.c_str(), batch[run], static_cast<unsigned long long>(report.Calls), rate, perCall);
+            break;
+        case Thunder::Benchmark::Format::JSON:
+            fprintf(output, "{\"label\":\"%s/cpu\",\"batch\":%u,\"calls\":%llu,\"calls_per_sec\":%.0f,\"cpu_ns_per_call\":%.0f}\n",
+                report.Label.c_str(), batch[run], static_cast<unsigned long long>(report.Calls), rate, perCall);
+            break;
+        default:
+            fprintf(output, "%-24s batch %5u, %10llu calls, %10.0f calls/s, %8.1f us CPU per call\n",
+                report.Label.c_str(), batch[run], static_cast<unsigned long long>(report.Calls), rate, perCall / 1000.0);
+            break;
+        }
+    }
+
+    for (Thunder::Benchmark::Result& report : reports) {
+        Thunder::Benchmark::Report(sink, options.Format, report);
+    }
+
+    return (((reports[0].Failures + reports[1].Failures) == 0) ? 0 : 1);
+}
+
+class EventData : public Core::JSON::Container {
+public:
+    EventData(const EventData&) = delete;
+    EventData& operator=(const EventData&) = delete;
+
+    EventData()
+        : Core::JSON::Container()
+        , Sequence(0)
+        , Timestamp(0)
+    {
+        Add(_T("seq"), &Sequence);
+        Add(_T("timestamp"), &Timestamp);
+    }
+    ~EventData() override
+    {
+    }
+
+public:
+    Core::JSON::DecUInt64 Sequence;
+    Core::JSON::DecUInt64 Timestamp; // microseconds since the epoch, taken when the event was sent
+};
+
+// Subscribes to -event (sent by JSONRPCPlugin, or by the WebSocketServerTest started with -emit)
+// and takes in whatever comes for <seconds>. A jump in the sequence numbers is a gap: events that
+// were dropped on the way, unless they still come in late. One that fills no gap is a duplicate. The latency runs from the timestamp in the event to the moment the
+// callback has it, both from the wall clock, so emitter and client have to share a host. Once
+// the client can not keep up, the latencies keep growing for as long as the run lasts.
+int RunEvents(const LoadOptions& options)
+{
+    struct State {
+        std::mutex Lock;
+        Thunder::Benchmark::Latencies Samples;
+        uint64_t Received;
+        uint64_t Missing;
+        uint64_t Reordered;
+        uint64_t Duplicates;
+        uint64_t Last;
+        std::map<uint64_t, uint64_t> Gaps; // first to last sequence of what is still missing
+    };
+
+    JSONRPC::LinkType<Core::JSON::IElement> remoteObject(_T("JSONRPCPlugin.1"), _T("client.events.1"));
+    State state;
+    state.Received = 0;
+    state.Missing = 0;
+    state.Reordered = 0;
+    state.Duplicates = 0;
+    state.Last = 0;
+
+    uint32_t result = remoteObject.Subscribe<EventData>(options.Timeout, options.Event, [&state](const EventData& data) {
+        uint64_t now = Core::Time::Now().Ticks();
+        uint64_t sequence = data.Sequence.Value();
+        uint64_t sent = data.Timestamp.Value();
+
+        std::unique_lock<std::mutex> guard(state.Lock);
+
+        // The first event sets the start, what was sent before the subscription does not count.
+        if ((state.Received != 0) && (sequence > (state.Last + 1))) {
+            state.Gaps[state.Last + 1] = sequence - 1;
+            state.Missing += sequence - (state.Last + 1);
+        } else if ((state.Received != 0) && (sequence <= state.Last)) {
+            std::map<uint64_t, uint64_t>::iterator gap(state.Gaps.upper_bound(sequence));
+
+            if ((gap != state.Gaps.begin()) && ((--gap)->second >= sequence)) {
+                // Counted as missing when the gap showed, it only came late.
+                uint64_t first = gap->first;
+                uint64_t last = gap->second;
+
+                state.Gaps.erase(gap);
+                if (first < sequence) {
+                    state.Gaps[first] = sequence - 1;
+                }
+                if (sequence < last) {
+                    state.Gaps[sequence + 1] = last;
+                }
+                state.Missing--;
+                state.Reordered++;
+            } else {
+                state.Duplicates++;
+            }
+        }
+
+        state.Last = std::max(state.Last, sequence);
+        state.Received++;
+        state.Samples.Add((now > sent ? now - sent : 0) * 1000);
+    });
+
+    if (result != Core::ERROR_NONE) {
+        fprintf(stderr, "Could not subscribe to %s: %s\n", options.Event.c_str(), Core::ErrorToString(result));
+        return (1);
+    }
+
+    uint64_t begin = Thunder::Benchmark::Now();
+    SleepMs(options.Events * 1000);
+    remoteObject.Unsubscribe(options.Timeout, options.Event);
+    uint64_t duration = Thunder::Benchmark::Now() - begin;
+
+    std::unique_lock<std::mutex> guard(state.Lock);
+
+    Thunder::Benchmark::Result report;
+    report.Label = options.Label + _T("/events/") + options.Event;
+    report.Threads = 1;
+    report.Calls = state.Received;
+    report.Failures = state.Missing;
+    report.Duration = duration;
+    report.Samples.Merge(state.Samples);
+
+    Thunder::Benchmark::Output sink(options.Output);
+    FILE* output = sink.File();
+
+    Thunder::Benchmark::Report(sink, options.Format, report);
+
+    double rate = state.Received / (duration / 1000000000.0);
+
+    switch (options.Format) {
+    case Thunder::Benchmark::Format::CSV:
+        fprintf(sink.Table(_T("delivery"), "label,received,events_per_sec,missing,reordered,duplicates"), "%s/delivery,%llu,%.0f,%llu,%llu,%llu\n", report.Label.c_str(), static_cast<unsigned long long>(state.Received), rate,
+            static_cast<unsigned long long>(state.Missing), static_cast<unsigned long long>(state.Reordered), static_cast<unsigned long long>(state.Duplicates));
+        break;
+    case Thunder::Benchmark::Format::JSON:
+        fprintf(output, "{\"label\":\"%s/delivery\",\"received\":%llu,\"events_per_sec\":%.0f,\"missing\":%llu,\"reordered\":%llu,\"duplicates\":%llu}\n", report.Label.c_str(),
+            static_cast<unsigned long long>(state.Received), rate, static_cast<unsigned long long>(state.Missing), static_cast<unsigned long long>(state.Reordered),
+            static_cast<unsigned long long>(state.Duplicates));
+        break;
+    default:
+        fprintf(output, "Events:       %llu received (%.0f/s), %llu missing, %llu out of order, %llu duplicates\n", static_cast<unsigned long long>(state.Received), rate,
+            static_cast<unsigned long long>(state.Missing), static_cast<unsigned long long>(state.Reordered), static_cast<unsigned long long>(state.Duplicates));
+        break;
+    }
+
+    return (((state.Received != 0) && (state.Missing == 0)) ? 0 : 1);
+}
+
+// Sends all <limit> time calls at once over one link, then collects the answers through futures.
+void RunPipelined(const uint32_t limit, const LoadOptions& options)
+{
+    JSONRPC::LinkType<Core::JSON::IElement> remoteObject(_T("JSONRPCPlugin.1"), _T("client.events.1"));
+    Client::AsyncTime pipeline(remoteObject, options.Timeout);
+    std::vector<std::future<Client::AsyncTime::Result>> answers;
+
+    uint64_t begin = Thunder::Benchmark::Now();
+
+    for (uint32_t index = 0; index < limit; index++) {
+        answers.push_back(pipeline.Time());
+    }
+
+    for (uint32_t index = 0; index < limit; index++) {
+        Client::AsyncTime::Result result(answers[index].get());
+        if (result.Error == Core::ERROR_NONE) {
+            printf("received time %u: %s\n", index, result.Time.c_str());
+        } else {
+            printf("time %u failed: %u\n", index, result.Error);
+        }
+    }
+
+    printf("%u calls in %.3f ms\n", limit, (Thunder::Benchmark::Now() - begin) / 1000000.0);
+}
+
 int main(int argc, char** argv)
 {
     uint32_t limit, delay, justDelay = 0;
+    LoadOptions load;
+    int exitCode = 0;
 
-    ParseOptions(argc, argv, limit, delay, justDelay);
+    if (ParseOptions(argc, argv, limit, delay, justDelay, load) == true) {
+        printf("Options:\n");
+        printf("-l <count> [number of time calls, default: 10]\n");
+        printf("-d <ms> [delay between the time calls, default: 300]\n");
+        printf("-j <ms> [one time call, then wait <ms>]\n");
+        printf("-load <seconds> [non-interactive, call time for <seconds> and report]\n");
+        printf("-threads <count> [threads calling, default: 1]\n");
+        printf("-links <count> [JSON-RPC links (connections) shared by the threads, default: 1]\n");
+        printf("-rate <requests/s> [open loop at this total rate, default: 0 (closed loop)]\n");
+        printf("-async <depth> [keep <depth> requests in flight per thread, default: 0 (blocking calls)]\n");
+        printf("               [without -load: send all -l calls at once and wait for the answers]\n");
+        printf("-batch <calls> [compare <calls> requests sent back to back with single calls, for -load seconds (default 5) each; no batch framing, every call is its own frame]\n");
+        printf("-events <seconds> [subscribe to -event and measure for <seconds> how many events come in, and how late]\n");
+        printf("-event <name> [event carrying {\"seq\":<n>,\"timestamp\":<us since epoch>}, default: tick]\n");
+        printf("-timeout <ms> [time to wait for an answer, default: 1000]\n");
+        printf("-format <text|csv|json> [report format, default: text]\n");
+        printf("-output <file> [append the report to this file, CSV tables other than the report go next to it as <file>.<table>, default: console]\n");
+        printf("-label <name> [tag for the report]\n");
+        printf("-h This text\n\n");
+        Core::Singleton::Dispose();
+        return (0);
+    }
 
     {
         printf("Preparing JSONRPC!!!\n");
@@ -68,22 +597,16 @@ int main(int argc, char** argv)
         Core::SystemInfo::SetEnvironment(_T("THUNDER_ACCESS"), (_T("127.0.0.1:55555")));
         #endif
 
-        JSONRPC::LinkType<Core::JSON::IElement> remoteObject(_T("JSONRPCPlugin.1"), _T("client.events.1"));
-
-        if(justDelay != 0)
-        {
-            Core::JSON::String result;
-            remoteObject.Invoke<void, Core::JSON::String>(1000, _T("time"), result);
-            printf("received time: %s\n", result.Value().c_str());
-            SleepMs(justDelay);
+        if (load.Events != 0) {
+            exitCode = RunEvents(load);
+        } else if (load.Batch != 0) {
+            exitCode = RunBatch(load);
+        } else if (load.Duration != 0) {
+            exitCode = RunLoad(load);
+        } else if (load.Depth != 0) {
+            RunPipelined(limit, load);
         } else {
-            for (int i = 0; i < limit; ++i)
-            {
-                Core::JSON::String result;
-                remoteObject.Invoke<void, Core::JSON::String>(1000, _T("time"), result);
-                printf("received time: %s\n", result.Value().c_str());
-                SleepMs(delay);
-            }
+            RunTime(limit, delay, justDelay);
         }
     }
 
@@ -91,5 +614,5 @@ int main(int argc, char** argv)
 
     Core::Singleton::Dispose();
 
-    return (0);
+    return (exitCode);
 }
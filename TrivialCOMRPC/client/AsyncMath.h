@@ -0,0 +1,199 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "../interface/ISimpleInterface.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Thunder {
+
+namespace Exchange {
+
+    // A COMRPC call blocks the calling thread until the answer is received, the channel itself
+    // however is multiplexed: calls from different threads travel over the same connection and
+    // their answers are matched to the caller, in whatever order the server completes them.
+    // AsyncMath uses that to keep up to <depth> IMath calls in flight for a single client thread,
+    // each call is handed to one of <depth> issuing threads and completed through a callback or
+    // a future. To actually get answers out of order, the server needs more than one invoke
+    // thread (see the -threads option of the SimpleService).
+    class AsyncMath {
+    public:
+        struct Result {
+            Result()
+                : Error(Core::ERROR_UNAVAILABLE)
+                , Value(0)
+            {
+            }
+
+            uint32_t Error;
+            uint16_t Value;
+        };
+
+        using Callback = std::function<void(const uint32_t error, const uint16_t value)>;
+
+    private:
+        enum class Operation {
+            ADD,
+            SUB
+        };
+
+        struct Job {
+            Operation Type;
+            uint16_t A;
+            uint16_t B;
+            Callback Completed;
+        };
+
+    public:
+        AsyncMath() = delete;
+        AsyncMath(const AsyncMath&) = delete;
+        AsyncMath& operator=(const AsyncMath&) = delete;
+
+        AsyncMath(IMath* math, const uint8_t depth)
+            : _math(math)
+            , _lock()
+            , _signal()
+            , _jobs()
+            , _issuers()
+            , _stopped(false)
+        {
+            ASSERT(math != nullptr);
+            ASSERT(depth > 0);
+
+            _math->AddRef();
+
+            for (uint8_t index = 0; index < depth; index++) {
+                _issuers.emplace_back(&AsyncMath::Issue, this);
+            }
+        }
+        ~AsyncMath()
+        {
+            {
+                std::unique_lock<std::mutex> guard(_lock);
+                _stopped = true;
+            }
+            _signal.notify_all();
+
+            for (std::thread& issuer : _issuers) {
+                issuer.join();
+            }
+
+            // Whatever was not issued yet, still deserves an answer.
+            for (Job& job : _jobs) {
+                job.Completed(Core::ERROR_UNAVAILABLE, 0);
+            }
+
+            _math->Release();
+        }
+
+    public:
+        // Callbacks are executed on one of the issuing threads, keep them short.
+        void Add(const uint16_t A, const uint16_t B, const Callback& completed)
+        {
+            Submit(Operation::ADD, A, B, completed);
+        }
+        void Sub(const uint16_t A, const uint16_t B, const Callback& completed)
+        {
+            Submit(Operation::SUB, A, B, completed);
+        }
+        std::future<Result> Add(const uint16_t A, const uint16_t B)
+        {
+            return (Submit(Operation::ADD, A, B));
+        }
+        std::future<Result> Sub(const uint16_t A, const uint16_t B)
+        {
+            return (Submit(Operation::SUB, A, B));
+        }
+
+    private:
+        std::future<Result> Submit(const Operation type, const uint16_t A, const uint16_t B)
+        {
+            std::shared_ptr<std::promise<Result>> promise(std::make_shared<std::promise<Result>>());
+
+            Submit(type, A, B, [promise](const uint32_t error, const uint16_t value) {
+                Result result;
+                result.Error = error;
+                result.Value = value;
+                promise->set_value(result);
+            });
+
+            return (promise->get_future());
+        }
+        void Submit(const Operation type, const uint16_t A, const uint16_t B, const Callback& completed)
+        {
+            bool accepted = false;
+            {
+                std::unique_lock<std::mutex> guard(_lock);
+
+                if (_stopped == false) {
+                    _jobs.push_back({ type, A, B, completed });
+                    accepted = true;
+                }
+            }
+
+            if (accepted == true) {
+                _signal.notify_one();
+            }
+            else {
+                completed(Core::ERROR_UNAVAILABLE, 0);
+            }
+        }
+        void Issue()
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+
+            while (true) {
+                _signal.wait(guard, [this]() { return ((_stopped == true) || (_jobs.empty() == false)); });
+
+                if (_stopped == true) {
+                    break;
+                }
+
+                Job job(std::move(_jobs.front()));
+                _jobs.pop_front();
+
+                guard.unlock();
+
+                uint16_t value = 0;
+                uint32_t error = (job.Type == Operation::ADD ? _math->Add(job.A, job.B, value) : _math->Sub(job.A, job.B, value));
+                job.Completed(error, value);
+
+                guard.lock();
+            }
+        }
+
+    private:
+        IMath* _math;
+        std::mutex _lock;
+        std::condition_variable _signal;
+        std::deque<Job> _jobs;
+        std::vector<std::thread> _issuers;
+        bool _stopped;
+    };
+}
+}
@@ -0,0 +1,60 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace Thunder {
+
+namespace Platform {
+
+    // "local:<name>" is shorthand for a unix domain socket in /tmp. When client and service live on
+    // the same box this skips the whole TCP/IP stack (no checksums, no loopback routing, no Nagle).
+    inline Core::NodeId Channel(const char* address)
+    {
+        static constexpr TCHAR LocalPrefix[] = _T("local:");
+        static constexpr size_t LocalPrefixLength = sizeof(LocalPrefix) - 1;
+
+        if (strncmp(address, LocalPrefix, LocalPrefixLength) == 0) {
+            return (Core::NodeId((string(_T("/tmp/")) + (address + LocalPrefixLength)).c_str()));
+        }
+
+        return (Core::NodeId(address));
+    }
+
+    // Resident set size, in KB, of the given process (0 is this process), 0 if it can not be determined.
+    inline uint32_t ResidentSize(const uint32_t pid)
+    {
+        uint32_t result = 0;
+        std::ifstream status(string(_T("/proc/")) + (pid == 0 ? string(_T("self")) : Core::NumberType<uint32_t>(pid).Text()) + _T("/status"));
+        string line;
+
+        while ((result == 0) && (std::getline(status, line))) {
+            if (line.compare(0, 6, _T("VmRSS:")) == 0) {
+                result = static_cast<uint32_t>(strtoul(line.c_str() + 6, nullptr, 10));
+            }
+        }
+
+        return (result);
+    }
+}
+}
@@ -22,8 +22,13 @@
 #include <core/core.h>
 #include <com/com.h>
 #include "../interface/ISimpleInterface.h"
+#include "AsyncMath.h"
+#include "Platform.h"
+#include "Statistics.h"
+#include <atomic>
 #include <iostream>
 #include <plugins/plugins.h>
+#include <thread>
 #include <vector>
 
 MODULE_NAME_DECLARATION(BUILD_REFERENCE)
@@ -36,15 +41,37 @@ enum class ServerType{
     STANDALONE_SERVER
 };
 
-bool ParseOptions(int argc, char** argv, Core::NodeId& comChannel, ServerType& type, string& callsign)
+struct BenchmarkOptions {
+    BenchmarkOptions()
+        : Enabled(false)
+        , Calls(10000)
+        , Threads(1)
+        , Depth(0)
+        , Format(Benchmark::Format::TEXT)
+        , Output()
+        , Label(_T("SimpleClient"))
+    {
+    }
+
+    bool Enabled;
+    uint32_t Calls;
+    uint32_t Threads;
+    uint8_t Depth;
+    Benchmark::Format Format;
+    string Output;
+    string Label;
+};
+
+bool ParseOptions(int argc, char** argv, Core::NodeId& comChannel, ServerType& type, string& callsign, BenchmarkOptions& bench)
 {
     int index = 1;
     bool showHelp = false;
     comChannel = Core::NodeId(Exchange::SimpleTestAddress);
+    type = ServerType::STANDALONE_SERVER;
 
     while ((index < argc) && (!showHelp)) {
         if (strcmp(argv[index], "-connect") == 0) {
-            comChannel = Core::NodeId(argv[index + 1]);
+            comChannel = Platform::Channel(argv[index + 1]);
             type = ServerType::STANDALONE_SERVER;
             index++;
         }
@@ -63,6 +90,31 @@ bool ParseOptions(int argc, char** argv, Core::NodeId& comChannel, ServerType& t
             }
             index++;
         }
+        else if ((strcmp(argv[index], "-bench") == 0) && ((index + 1) < argc)) {
+            bench.Enabled = true;
+            bench.Calls = atoi(argv[index + 1]);
+            index++;
+        }
+        else if ((strcmp(argv[index], "-threads") == 0) && ((index + 1) < argc)) {
+            bench.Threads = std::max(atoi(argv[index + 1]), 1);
+            index++;
+        }
+        else if ((strcmp(argv[index], "-async") == 0) && ((index + 1) < argc)) {
+            bench.Depth = static_cast<uint8_t>(std::min(std::max(atoi(argv[index + 1]), 1), 255));
+            index++;
+        }
+        else if ((strcmp(argv[index], "-format") == 0) && ((index + 1) < argc)) {
+            showHelp = (Benchmark::ParseFormat(argv[index + 1], bench.Format) == false);
+            index++;
+        }
+        else if ((strcmp(argv[index], "-output") == 0) && ((index + 1) < argc)) {
+            bench.Output = argv[index + 1];
+            index++;
+        }
+        else if ((strcmp(argv[index], "-label") == 0) && ((index + 1) < argc)) {
+            bench.Label = argv[index + 1];
+            index++;
+        }
         else if (strcmp(argv[index], "-h") == 0) {
             showHelp = true;
         }
@@ -72,6 +124,175 @@ bool ParseOptions(int argc, char** argv, Core::NodeId& comChannel, ServerType& t
     return (showHelp);
 }
 
+Exchange::IMath* AcquireMath(RPC::CommunicatorClient& client, const ServerType type, const string& callsign)
+{
+    Exchange::IMath* math = nullptr;
+
+    if (type == ServerType::STANDALONE_SERVER) {
+        printf("Acquiring\n");
+        math = client.Acquire<Exchange::IMath>(8000, _T("Math"), ~0);
+    }
+    else {
+        Thunder::PluginHost::IShell* controller = client.Acquire<Thunder::PluginHost::IShell>(10000, _T("Controller"), ~0);
+        if (controller == nullptr) {
+            printf("Could not get the IShell* interface from the controller to execute the QueryInterfaceByCallsign!\n");
+        }
+        else {
+            math = controller->QueryInterfaceByCallsign<Exchange::IMath>(callsign);
+            controller->Release();
+        }
+    }
+
+    return (math);
+}
+
+// Hammers IMath::Add from a number of threads sharing one channel and one proxy, so what is
+// measured is the COMRPC path itself: marshalling, transport and the server side dispatching.
+void RunSynchronous(Exchange::IMath* math, const BenchmarkOptions& options, Benchmark::Result& report)
+{
+    std::vector<Benchmark::Latencies> samples(options.Threads);
+    std::vector<uint64_t> failures(options.Threads, 0);
+    std::vector<std::thread> workers;
+    std::atomic<bool> start(false);
+
+    for (uint32_t thread = 0; thread < options.Threads; thread++) {
+        workers.emplace_back([&, thread]() {
+            Benchmark::Latencies& latencies(samples[thread]);
+            latencies.Reserve(options.Calls);
+
+            while (start.load() == false) {
+                std::this_thread::yield();
+            }
+
+            for (uint32_t call = 0; call < options.Calls; call++) {
+                uint16_t x = static_cast<uint16_t>(call);
+                uint16_t y = static_cast<uint16_t>(thread);
+                uint16_t sum = 0;
+
+                uint64_t begin = Benchmark::Now();
+                uint32_t error = math->Add(x, y, sum);
+                latencies.Add(Benchmark::Now() - begin);
+
+                if ((error != Core::ERROR_NONE) || (sum != static_cast<uint16_t>(x + y))) {
+                    failures[thread]++;
+                }
+            }
+        });
+    }
+
+    uint64_t begin = Benchmark::Now();
+    start = true;
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    report.Duration = Benchmark::Now() - begin;
+    report.Threads = options.Threads;
+
+    for (uint32_t thread = 0; thread < options.Threads; thread++) {
+        report.Samples.Merge(samples[thread]);
+        report.Failures += failures[thread];
+    }
+}
+
+// One thread submits all calls through the AsyncMath, keeping <depth> of them in flight. The
+// latency is measured from submission till the completion callback.
+void RunPipelined(Exchange::IMath* math, const BenchmarkOptions& options, Benchmark::Result& report)
+{
+    std::vector<uint64_t> durations(options.Calls, 0);
+    std::atomic<uint32_t> outstanding(0);
+    std::atomic<uint32_t> failures(0);
+
+    {
+        Exchange::AsyncMath async(math, options.Depth);
+
+        uint64_t begin = Benchmark::Now();
+
+        for (uint32_t call = 0; call < options.Calls; call++) {
+            uint16_t x = static_cast<uint16_t>(call);
+            uint16_t y = static_cast<uint16_t>(call >> 16);
+
+            while (outstanding.load() >= options.Depth) {
+                std::this_thread::yield();
+            }
+
+            outstanding++;
+            uint64_t submitted = Benchmark::Now();
+
+            async.Add(x, y, [&, call, submitted, x, y](const uint32_t error, const uint16_t sum) {
+                durations[call] = Benchmark::Now() - submitted;
+                if ((error != Core::ERROR_NONE) || (sum != static_cast<uint16_t>(x + y))) {
+                    failures++;
+                }
+                outstanding--;
+            });
+        }
+
+        while (outstanding.load() != 0) {
+            std::this_thread::yield();
+        }
+
+        report.Duration = Benchmark::Now() - begin;
+    }
+
+    report.Threads = 1;
+    report.Failures = failures.load();
+    report.Samples.Reserve(options.Calls);
+    for (const uint64_t duration : durations) {
+        report.Samples.Add(duration);
+    }
+}
+
+int RunBenchmark(RPC::CommunicatorClient& client, const ServerType type, const string& callsign, const BenchmarkOptions& options)
+{
+    int result = 1;
+
+    if (client.IsOpen() == false) {
+        client.Open(2000);
+    }
+
+    Exchange::IMath* math = (client.IsOpen() == true ? AcquireMath(client, type, callsign) : nullptr);
+
+    if (math == nullptr) {
+        fprintf(stderr, "Could not acquire the IMath, benchmark aborted\n");
+    }
+    else {
+        Benchmark::Output sink(options.Output);
+
+        // Warm up, the first call(s) also pay for the proxy and the lazy setup on the server side.
+        for (uint16_t index = 0; index < 16; index++) {
+            uint16_t sum;
+            math->Add(index, index, sum);
+        }
+
+        Benchmark::Result report;
+        report.Label = options.Label;
+        report.Depth = options.Depth;
+
+        if (options.Depth == 0) {
+            RunSynchronous(math, options, report);
+        }
+        else {
+            RunPipelined(math, options, report);
+        }
+
+        report.Calls = report.Samples.Count();
+
+        Benchmark::Report(sink, options.Format, report);
+
+        math->Release();
+
+        result = (report.Failures == 0 ? 0 : 1);
+    }
+
+    if (client.IsOpen() == true) {
+        client.Close(Core::infinite);
+    }
+
+    return (result);
+}
+
 
 int main(int argc, char* argv[])
 {
@@ -80,16 +301,29 @@ int main(int argc, char* argv[])
     Core::NodeId comChannel;
     ServerType type;
     string callsign;
+    BenchmarkOptions bench;
     Exchange::IMath* math = nullptr;
+    int exitCode = 0;
 
     printf("\nSimpleClient is the counterpart for the SimpleServer\n");
 
-    if (ParseOptions(argc, argv, comChannel, type, callsign) == true) {
+    if (ParseOptions(argc, argv, comChannel, type, callsign, bench) == true) {
         printf("Options:\n");
-        printf("-connect <IP/FQDN>:<port> [default: %s]\n", Exchange::SimpleTestAddress);
+        printf("-connect <IP/FQDN>:<port> | local:<name> [default: %s]\n", Exchange::SimpleTestAddress);
         printf("-plugin <callsign> [use plugin server and not the stand-alone version]\n");
+        printf("-bench <calls> [non-interactive, every thread performs <calls> IMath::Add calls and reports the latencies]\n");
+        printf("-threads <count> [number of benchmark threads, default: 1]\n");
+        printf("-async <depth> [benchmark through the AsyncMath with <depth> calls in flight from one thread, ignores -threads]\n");
+        printf("-format <text|csv|json> [benchmark report format, default: text]\n");
+        printf("-output <file> [append the benchmark report to this file, default: console]\n");
+        printf("-label <name> [tag for the benchmark report, e.g. the Thunder version under test]\n");
         printf("-h This text\n\n");
     }
+    else if (bench.Enabled == true)
+    {
+        Core::ProxyType<RPC::CommunicatorClient> client(Core::ProxyType<RPC::CommunicatorClient>::Create(comChannel));
+        exitCode = RunBenchmark(*client, type, callsign, bench);
+    }
     else
     {
         int element;
@@ -141,20 +375,7 @@ int main(int argc, char* argv[])
                         printf("Could not open a connection to the server. No exchange of interfaces happened!\n");
                         break;
                     } else {
-                        if (type == ServerType::STANDALONE_SERVER) {
-                            printf("Acquiring\n");
-                            math = client->Acquire<Exchange::IMath>(8000, _T("Math"), ~0);
-                        }
-                        else {
-                            Thunder::PluginHost::IShell* controller = client->Acquire<Thunder::PluginHost::IShell>(10000, _T("Controller"), ~0);
-                            if (controller == nullptr) {
-                                printf("Could not get the IShell* interface from the controller to execute the QueryInterfaceByCallsign!\n");
-                            }
-                            else {
-                                math = controller->QueryInterfaceByCallsign<Exchange::IMath>(callsign);
-                                controller->Release();
-                            }
-                        }
+                        math = AcquireMath(*client, type, callsign);
                     }
 
                     if (math == nullptr) {
@@ -212,6 +433,85 @@ int main(int argc, char* argv[])
                     printf("The Difference of %d and %d is: %d\n", x,y,diff);
                 }
                 break;
+            case 'B':
+                if (math == nullptr) {
+                    printf("We do not have a math interface, so we can not perform a batch add\n");
+                }
+                else {
+                    uint16_t length;
+                    cout << "How many elements: ";
+                    cin >> length;
+
+                    std::vector<uint16_t> x(length), y(length), sum(length);
+                    for (uint16_t index = 0; index < length; index++) {
+                        x[index] = index;
+                        y[index] = static_cast<uint16_t>(length - index);
+                    }
+
+                    uint32_t result = math->AddBatch(length, x.data(), y.data(), sum.data());
+                    if (result != Core::ERROR_NONE) {
+                        printf("AddBatch failed: %d\n", result);
+                    }
+                    else {
+                        uint16_t failures = 0;
+                        for (uint16_t index = 0; index < length; index++) {
+                            if (sum[index] != static_cast<uint16_t>(x[index] + y[index])) {
+                                failures++;
+                            }
+                        }
+                        printf("Added %d pairs in one call, %d mismatches\n", length, failures);
+                    }
+                }
+                break;
+            case 'R':
+                if (math == nullptr) {
+                    printf("We do not have a math interface, so we can not perform a reduction\n");
+                }
+                else {
+                    Exchange::IMath2* math2 = math->QueryInterface<Exchange::IMath2>();
+
+                    if (math2 == nullptr) {
+                        printf("The server does not offer the IMath2 interface\n");
+                    }
+                    else {
+                        uint16_t length;
+                        cout << "How many elements: ";
+                        cin >> length;
+
+                        // Large enough to show the 64 bit range, small enough not to overflow.
+                        std::vector<int64_t> values(length);
+                        std::vector<double> weights(length);
+                        for (uint16_t index = 0; index < length; index++) {
+                            values[index] = (static_cast<int64_t>(index) - (length / 2)) * 1000000000LL;
+                            weights[index] = 1.0 / (index + 1);
+                        }
+
+                        int64_t sum = 0, min = 0, max = 0;
+                        double product = 0.0;
+                        std::vector<double> real(values.begin(), values.end());
+
+                        uint32_t result = math2->Sum(length, values.data(), sum);
+                        if (result == Core::ERROR_NONE) {
+                            result = math2->Min(length, values.data(), min);
+                        }
+                        if (result == Core::ERROR_NONE) {
+                            result = math2->Max(length, values.data(), max);
+                        }
+                        if (result == Core::ERROR_NONE) {
+                            result = math2->Dot(length, real.data(), weights.data(), product);
+                        }
+
+                        if (result != Core::ERROR_NONE) {
+                            printf("Reduction failed: %d\n", result);
+                        }
+                        else {
+                            printf("Sum: %lld, Min: %lld, Max: %lld, weighted sum: %f\n", static_cast<long long>(sum), static_cast<long long>(min), static_cast<long long>(max), product);
+                        }
+
+                        math2->Release();
+                    }
+                }
+                break;
 	    case 'E': exit(0); break;
             case 'Q': break;
             case'?':
@@ -221,6 +521,8 @@ int main(int argc, char* argv[])
                 printf("<D> Destroy the Math interface.\n");
                 printf("<A> Add 2 numbers.\n");
                 printf("<S> Subtract 2 numbers.\n");
+                printf("<B> Add a vector of numbers in one call.\n");
+                printf("<R> Sum, Min, Max and Dot of a vector of 64 bit numbers, through the IMath2.\n");
                 printf("<Q> We are done playing around, eave the application properly.\n");
                 printf("<E> Eject, this is an emergency, bail out, just kill the app.\n");
                 printf("<?> Have no clue what I can do, tell me.\n");
@@ -241,5 +543,5 @@ int main(int argc, char* argv[])
 
     Core::Singleton::Dispose();
 
-    return 0;
+    return (exitCode);
 }
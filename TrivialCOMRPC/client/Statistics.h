@@ -0,0 +1,341 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Thunder {
+
+namespace Benchmark {
+
+    enum class Format {
+        TEXT,
+        CSV,
+        JSON
+    };
+
+    inline bool ParseFormat(const char* text, Format& format)
+    {
+        bool result = true;
+
+        if (strcmp(text, "text") == 0) {
+            format = Format::TEXT;
+        } else if (strcmp(text, "csv") == 0) {
+            format = Format::CSV;
+        } else if (strcmp(text, "json") == 0) {
+            format = Format::JSON;
+        } else {
+            result = false;
+        }
+
+        return (result);
+    }
+
+    // Monotonic timestamp in nanoseconds, only meaningful as a difference between two samples.
+    inline uint64_t Now()
+    {
+        return (static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()));
+    }
+
+    // Collects raw latency samples (in nanoseconds). Every thread should record into its own
+    // instance, they are merged once the run is over, so recording never takes a lock.
+    class Latencies {
+    public:
+        static constexpr uint8_t Buckets = 40;
+
+        Latencies(const Latencies&) = default;
+        Latencies& operator=(const Latencies&) = default;
+
+        Latencies()
+            : _samples()
+            , _sorted(true)
+        {
+        }
+        ~Latencies() = default;
+
+    public:
+        void Reserve(const uint32_t count)
+        {
+            _samples.reserve(count);
+        }
+        void Add(const uint64_t nanoSeconds)
+        {
+            _samples.push_back(nanoSeconds);
+            _sorted = false;
+        }
+        void Merge(const Latencies& other)
+        {
+            _samples.insert(_samples.end(), other._samples.begin(), other._samples.end());
+            _sorted = false;
+        }
+        uint64_t Count() const
+        {
+            return (_samples.size());
+        }
+        uint64_t Min()
+        {
+            Sort();
+            return (_samples.empty() ? 0 : _samples.front());
+        }
+        uint64_t Max()
+        {
+            Sort();
+            return (_samples.empty() ? 0 : _samples.back());
+        }
+        uint64_t Mean() const
+        {
+            uint64_t total = 0;
+            for (const uint64_t sample : _samples) {
+                total += sample;
+            }
+            return (_samples.empty() ? 0 : (total / _samples.size()));
+        }
+        // Nearest rank percentile, percentile in the range [0, 100].
+        uint64_t Percentile(const double percentile)
+        {
+            uint64_t result = 0;
+
+            Sort();
+
+            if (_samples.empty() == false) {
+                size_t rank = static_cast<size_t>((percentile / 100.0) * _samples.size());
+                result = _samples[std::min(rank, _samples.size() - 1)];
+            }
+
+            return (result);
+        }
+        // Power of two buckets: bucket N holds the samples in [2^N, 2^(N+1)) nanoseconds.
+        std::vector<uint64_t> Histogram() const
+        {
+            std::vector<uint64_t> buckets(Buckets, 0);
+
+            for (const uint64_t sample : _samples) {
+                uint8_t bucket = 0;
+                uint64_t value = sample;
+                while ((value > 1) && (bucket < (Buckets - 1))) {
+                    value >>= 1;
+                    bucket++;
+                }
+                buckets[bucket]++;
+            }
+
+            return (buckets);
+        }
+
+    private:
+        void Sort()
+        {
+            if (_sorted == false) {
+                std::sort(_samples.begin(), _samples.end());
+                _sorted = true;
+            }
+        }
+
+    private:
+        std::vector<uint64_t> _samples;
+        bool _sorted;
+    };
+
+    // Where a report goes: appended to a file, or the console if there is none or it can not be
+    // opened. Every CSV table has a schema of its own, so each goes to a file of its own: the
+    // reports to the file itself, a table <name> next to it, "results.csv" gives "results.<name>.csv".
+    // A table gets its header when it first appears in a file that is still empty.
+    class Output {
+    public:
+        Output() = delete;
+        Output(const Output&) = delete;
+        Output& operator=(const Output&) = delete;
+
+        Output(const std::string& fileName)
+            : _fileName()
+            , _file(stdout)
+            , _tables()
+        {
+            if (fileName.empty() == false) {
+                FILE* file = Open(fileName);
+
+                if (file != nullptr) {
+                    _fileName = fileName;
+                    _file = file;
+                }
+            }
+        }
+        ~Output()
+        {
+            for (const std::pair<const std::string, FILE*>& table : _tables) {
+                if ((table.second != _file) && (table.second != stdout)) {
+                    fclose(table.second);
+                }
+            }
+            if (_file != stdout) {
+                fclose(_file);
+            } else {
+                fflush(_file);
+            }
+        }
+
+    public:
+        FILE* File() const
+        {
+            return (_file);
+        }
+        // The stream for the CSV rows of table <name>, an empty name being the reports.
+        FILE* Table(const std::string& name, const char* header)
+        {
+            std::map<std::string, FILE*>::const_iterator entry(_tables.find(name));
+
+            if (entry == _tables.end()) {
+                FILE* file = _file;
+
+                if ((_fileName.empty() == false) && (name.empty() == false) && ((file = Open(FileName(name))) == nullptr)) {
+                    file = stdout;
+                }
+                if ((file == stdout) || (ftell(file) == 0)) {
+                    fprintf(file, "%s\n", header);
+                }
+
+                entry = _tables.emplace(name, file).first;
+            }
+
+            return (entry->second);
+        }
+
+    private:
+        std::string FileName(const std::string& name) const
+        {
+            size_t slash = _fileName.find_last_of('/');
+            size_t dot = _fileName.find_last_of('.');
+
+            if ((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash))) {
+                dot = _fileName.length();
+            }
+
+            return (_fileName.substr(0, dot) + '.' + name + _fileName.substr(dot));
+        }
+        static FILE* Open(const std::string& fileName)
+        {
+            FILE* file = fopen(fileName.c_str(), "a");
+
+            if (file == nullptr) {
+                fprintf(stderr, "Could not open %s, reporting to the console\n", fileName.c_str());
+            } else {
+                fseek(file, 0, SEEK_END);
+            }
+
+            return (file);
+        }
+
+    private:
+        std::string _fileName;
+        FILE* _file;
+        std::map<std::string, FILE*> _tables;
+    };
+
+    struct Result {
+        Result()
+            : Label()
+            , Threads(0)
+            , Depth(0)
+            , Calls(0)
+            , Failures(0)
+            , Duration(0)
+            , Samples()
+        {
+        }
+
+        std::string Label;
+        uint32_t Threads;
+        uint32_t Depth; // calls kept in flight by one thread, 0 for plain blocking calls
+        uint64_t Calls;
+        uint64_t Failures;
+        uint64_t Duration; // wall clock of the whole run in nanoseconds
+        Latencies Samples;
+    };
+
+    inline void Report(Output& sink, const Format format, Result& result)
+    {
+        FILE* output = sink.File();
+        double seconds = static_cast<double>(result.Duration) / 1000000000.0;
+        double throughput = (seconds > 0 ? (static_cast<double>(result.Calls) / seconds) : 0.0);
+
+        uint64_t p50 = result.Samples.Percentile(50.0);
+        uint64_t p90 = result.Samples.Percentile(90.0);
+        uint64_t p99 = result.Samples.Percentile(99.0);
+        uint64_t p999 = result.Samples.Percentile(99.9);
+
+        switch (format) {
+        case Format::CSV:
+            fprintf(sink.Table(std::string(), "label,threads,depth,calls,failures,seconds,calls_per_sec,min_ns,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns"), "%s,%u,%u,%llu,%llu,%.3f,%.0f,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+                result.Label.c_str(), result.Threads, result.Depth,
+                static_cast<unsigned long long>(result.Calls), static_cast<unsigned long long>(result.Failures),
+                seconds, throughput,
+                static_cast<unsigned long long>(result.Samples.Min()), static_cast<unsigned long long>(result.Samples.Mean()),
+                static_cast<unsigned long long>(p50), static_cast<unsigned long long>(p90),
+                static_cast<unsigned long long>(p99), static_cast<unsigned long long>(p999),
+                static_cast<unsigned long long>(result.Samples.Max()));
+            break;
+        case Format::JSON: {
+            fprintf(output, "{\"label\":\"%s\",\"threads\":%u,\"depth\":%u,\"calls\":%llu,\"failures\":%llu,\"seconds\":%.3f,\"calls_per_sec\":%.0f,"
+                            "\"latency_ns\":{\"min\":%llu,\"mean\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu},\"histogram\":[",
+                result.Label.c_str(), result.Threads, result.Depth,
+                static_cast<unsigned long long>(result.Calls), static_cast<unsigned long long>(result.Failures),
+                seconds, throughput,
+                static_cast<unsigned long long>(result.Samples.Min()), static_cast<unsigned long long>(result.Samples.Mean()),
+                static_cast<unsigned long long>(p50), static_cast<unsigned long long>(p90),
+                static_cast<unsigned long long>(p99), static_cast<unsigned long long>(p999),
+                static_cast<unsigned long long>(result.Samples.Max()));
+            std::vector<uint64_t> buckets(result.Samples.Histogram());
+            for (uint8_t index = 0; index < buckets.size(); index++) {
+                fprintf(output, "%s%llu", (index == 0 ? "" : ","), static_cast<unsigned long long>(buckets[index]));
+            }
+            fprintf(output, "]}\n");
+            break;
+        }
+        default: {
+            fprintf(output, "Label:        %s\n", result.Label.c_str());
+            fprintf(output, "Threads:      %u\n", result.Threads);
+            fprintf(output, "In flight:    %u\n", (result.Depth == 0 ? 1 : result.Depth));
+            fprintf(output, "Calls:        %llu (%llu failed)\n", static_cast<unsigned long long>(result.Calls), static_cast<unsigned long long>(result.Failures));
+            fprintf(output, "Duration:     %.3f s\n", seconds);
+            fprintf(output, "Throughput:   %.0f calls/s\n", throughput);
+            fprintf(output, "Latency [us]: min %.1f, mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+                result.Samples.Min() / 1000.0, result.Samples.Mean() / 1000.0,
+                p50 / 1000.0, p90 / 1000.0, p99 / 1000.0, p999 / 1000.0,
+                result.Samples.Max() / 1000.0);
+            fprintf(output, "Histogram:\n");
+            std::vector<uint64_t> buckets(result.Samples.Histogram());
+            for (uint8_t index = 0; index < buckets.size(); index++) {
+                if (buckets[index] != 0) {
+                    fprintf(output, "  < %12llu ns: %llu\n", (1ULL << (index + 1)), static_cast<unsigned long long>(buckets[index]));
+                }
+            }
+            break;
+        }
+        }
+    }
+}
+}
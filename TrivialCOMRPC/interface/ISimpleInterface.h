@@ -30,7 +30,8 @@ namespace Exchange {
     }
 
     enum example_ids {
-        ID_MATH = 0x80001002
+        ID_MATH = 0x80001002,
+        ID_MATH2 = 0x80001003
     };
 
     // This is an example to show the workings and how to develope a COMRPC/JSONRPC method/interface
@@ -42,7 +43,31 @@ namespace Exchange {
 
         virtual uint32_t Add(const uint16_t A, const uint16_t B, uint16_t& sum /* @out */)  const = 0;
         virtual uint32_t Sub(const uint16_t A, const uint16_t B, uint16_t& diff /* @out */)  const = 0;
+
+        // Element wise variants of the above, so a whole vector of operands is handled in a single round-trip.
+        virtual uint32_t AddBatch(const uint16_t length, const uint16_t A[] /* @in @length:length */, const uint16_t B[] /* @in @length:length */, uint16_t sum[] /* @out @length:length */) const = 0;
+        virtual uint32_t SubBatch(const uint16_t length, const uint16_t A[] /* @in @length:length */, const uint16_t B[] /* @in @length:length */, uint16_t diff[] /* @out @length:length */) const = 0;
+    };
+
+    // Successor of the IMath for real life figures: 64 bit integers (no silent wraparound, a result
+    // that does not fit is reported as Core::ERROR_INVALID_RANGE), doubles, and reductions that
+    // aggregate a whole array on the service side in a single call.
+    struct IMath2 : virtual public Core::IUnknown {
+
+        enum { ID = ID_MATH2 };
+
+        ~IMath2() override = default;
+
+        virtual uint32_t Add64(const int64_t A, const int64_t B, int64_t& sum /* @out */) const = 0;
+        virtual uint32_t Sub64(const int64_t A, const int64_t B, int64_t& diff /* @out */) const = 0;
+        virtual uint32_t AddDouble(const double A, const double B, double& sum /* @out */) const = 0;
+        virtual uint32_t SubDouble(const double A, const double B, double& diff /* @out */) const = 0;
+
+        // Min and Max of an empty array are undefined and return Core::ERROR_BAD_REQUEST.
+        virtual uint32_t Sum(const uint16_t length, const int64_t values[] /* @in @length:length */, int64_t& sum /* @out */) const = 0;
+        virtual uint32_t Min(const uint16_t length, const int64_t values[] /* @in @length:length */, int64_t& min /* @out */) const = 0;
+        virtual uint32_t Max(const uint16_t length, const int64_t values[] /* @in @length:length */, int64_t& max /* @out */) const = 0;
+        virtual uint32_t Dot(const uint16_t length, const double A[] /* @in @length:length */, const double B[] /* @in @length:length */, double& product /* @out */) const = 0;
     };
 }
 }
-
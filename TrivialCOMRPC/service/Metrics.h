@@ -0,0 +1,273 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+namespace Thunder {
+
+namespace Service {
+
+    // Call statistics of the service. Everything is kept in atomics, so recording a call from
+    // any of the invoke threads never blocks, not even while a dump is in progress. A dump is
+    // therefore not a consistent snapshot, the individual figures are.
+    class Metrics {
+    public:
+        enum method : uint8_t {
+            ACQUIRE,
+            MATH_ADD,
+            MATH_SUB,
+            MATH_ADDBATCH,
+            MATH_SUBBATCH,
+            MATH2_ADD64,
+            MATH2_SUB64,
+            MATH2_ADDDOUBLE,
+            MATH2_SUBDOUBLE,
+            MATH2_SUM,
+            MATH2_MIN,
+            MATH2_MAX,
+            MATH2_DOT,
+            METHODS
+        };
+
+        static uint64_t Now()
+        {
+            return (static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()));
+        }
+
+    private:
+        // Bucket N counts the samples in [2^N, 2^(N+1)) nanoseconds, the last one everything above.
+        class Statistics {
+        public:
+            static constexpr uint8_t Buckets = 32;
+
+            Statistics(const Statistics&) = delete;
+            Statistics& operator=(const Statistics&) = delete;
+
+            Statistics()
+                : _count(0)
+                , _total(0)
+                , _max(0)
+                , _inFlight(0)
+                , _buckets()
+            {
+                for (uint8_t index = 0; index < Buckets; index++) {
+                    _buckets[index] = 0;
+                }
+            }
+            ~Statistics() = default;
+
+        public:
+            void Enter()
+            {
+                _inFlight.fetch_add(1, std::memory_order_relaxed);
+            }
+            void Leave(const uint64_t duration)
+            {
+                _inFlight.fetch_sub(1, std::memory_order_relaxed);
+                Record(duration);
+            }
+            void Record(const uint64_t duration)
+            {
+                _count.fetch_add(1, std::memory_order_relaxed);
+                _total.fetch_add(duration, std::memory_order_relaxed);
+                _buckets[Bucket(duration)].fetch_add(1, std::memory_order_relaxed);
+
+                uint64_t max = _max.load(std::memory_order_relaxed);
+                while ((duration > max) && (_max.compare_exchange_weak(max, duration, std::memory_order_relaxed) == false)) {
+                }
+            }
+            void Dump(FILE* output, const TCHAR* name) const
+            {
+                uint64_t count = _count.load(std::memory_order_relaxed);
+
+                if (count == 0) {
+                    fprintf(output, "  %-22s %10u calls\n", name, 0);
+                }
+                else {
+                    fprintf(output, "  %-22s %10llu calls, %4d in flight, mean %9.1f us, p50 < %9.1f us, p99 < %9.1f us, max %9.1f us\n",
+                        name, static_cast<unsigned long long>(count),
+                        _inFlight.load(std::memory_order_relaxed),
+                        (_total.load(std::memory_order_relaxed) / count) / 1000.0,
+                        Percentile(count, 50) / 1000.0,
+                        Percentile(count, 99) / 1000.0,
+                        _max.load(std::memory_order_relaxed) / 1000.0);
+                }
+            }
+
+        private:
+            static uint8_t Bucket(uint64_t duration)
+            {
+                uint8_t bucket = 0;
+                while ((duration > 1) && (bucket < (Buckets - 1))) {
+                    duration >>= 1;
+                    bucket++;
+                }
+                return (bucket);
+            }
+            // Upper bound of the bucket holding the given percentile, good enough to spot trends.
+            uint64_t Percentile(const uint64_t count, const uint8_t percentile) const
+            {
+                uint64_t threshold = ((count * percentile) + 99) / 100;
+                uint64_t seen = 0;
+                uint8_t bucket = 0;
+
+                while ((bucket < (Buckets - 1)) && ((seen += _buckets[bucket].load(std::memory_order_relaxed)) < threshold)) {
+                    bucket++;
+                }
+
+                return (1ULL << (bucket + 1));
+            }
+
+        private:
+            std::atomic<uint64_t> _count;
+            std::atomic<uint64_t> _total;
+            std::atomic<uint64_t> _max;
+            std::atomic<int32_t> _inFlight;
+            std::atomic<uint64_t> _buckets[Buckets];
+        };
+
+    public:
+        class Scope {
+        public:
+            Scope() = delete;
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+            Scope(Metrics& metrics, const method id)
+                : _statistics(metrics._methods[id])
+                , _start(Now())
+            {
+                _statistics.Enter();
+            }
+            ~Scope()
+            {
+                _statistics.Leave(Now() - _start);
+            }
+
+        private:
+            Statistics& _statistics;
+            const uint64_t _start;
+        };
+
+    public:
+        Metrics(const Metrics&) = delete;
+        Metrics& operator=(const Metrics&) = delete;
+
+        // The engine queue is FIFO, so the N-th job dispatched is the N-th one that arrived. Its
+        // arrival time is parked in a ring that holds at least <pending> of them, the most that
+        // can have arrived and not yet be dispatched, so no slot is reused before it is read.
+        Metrics(const uint64_t pending)
+            : _methods()
+            , _arrived(0)
+            , _dispatched(0)
+            , _slots(Slots(pending))
+            , _arrivals(new std::atomic<uint64_t>[_slots])
+            , _queueWait()
+            , _dispatch()
+        {
+            for (uint64_t index = 0; index < _slots; index++) {
+                _arrivals[index] = 0;
+            }
+        }
+        ~Metrics() = default;
+
+    public:
+        // A message was handed to the engine, called from the communication thread.
+        void Arrived()
+        {
+            uint64_t slot = _arrived.load(std::memory_order_relaxed);
+            _arrivals[slot & (_slots - 1)].store(Now(), std::memory_order_relaxed);
+            _arrived.store(slot + 1, std::memory_order_release);
+        }
+        // An engine thread picks up the next message, returns the moment it did so.
+        uint64_t Dispatching()
+        {
+            uint64_t now = Now();
+            uint64_t slot = _dispatched.fetch_add(1, std::memory_order_relaxed);
+
+            if (slot < _arrived.load(std::memory_order_acquire)) {
+                uint64_t arrival = _arrivals[slot & (_slots - 1)].load(std::memory_order_relaxed);
+                _queueWait.Record(now > arrival ? now - arrival : 0);
+            }
+
+            _dispatch.Enter();
+            return (now);
+        }
+        void Dispatched(const uint64_t started)
+        {
+            _dispatch.Leave(Now() - started);
+        }
+        void Dump(FILE* output) const
+        {
+            static const TCHAR* names[METHODS] = {
+                _T("Acquire"),
+                _T("IMath::Add"),
+                _T("IMath::Sub"),
+                _T("IMath::AddBatch"),
+                _T("IMath::SubBatch"),
+                _T("IMath2::Add64"),
+                _T("IMath2::Sub64"),
+                _T("IMath2::AddDouble"),
+                _T("IMath2::SubDouble"),
+                _T("IMath2::Sum"),
+                _T("IMath2::Min"),
+                _T("IMath2::Max"),
+                _T("IMath2::Dot")
+            };
+
+            uint64_t arrived = _arrived.load(std::memory_order_relaxed);
+            uint64_t dispatched = _dispatched.load(std::memory_order_relaxed);
+
+            fprintf(output, "Methods:\n");
+            for (uint8_t index = 0; index < METHODS; index++) {
+                _methods[index].Dump(output, names[index]);
+            }
+            fprintf(output, "Invoke engine (%llu pending):\n", static_cast<unsigned long long>(arrived > dispatched ? arrived - dispatched : 0));
+            _queueWait.Dump(output, _T("queue wait"));
+            _dispatch.Dump(output, _T("dispatch"));
+            fflush(output);
+        }
+
+    private:
+        static uint64_t Slots(const uint64_t pending)
+        {
+            uint64_t slots = 1;
+            while (slots < pending) {
+                slots <<= 1;
+            }
+            return (slots);
+        }
+
+    private:
+        Statistics _methods[METHODS];
+        std::atomic<uint64_t> _arrived;
+        std::atomic<uint64_t> _dispatched;
+        const uint64_t _slots; // a power of two
+        std::unique_ptr<std::atomic<uint64_t>[]> _arrivals;
+        Statistics _queueWait;
+        Statistics _dispatch;
+    };
+}
+}
@@ -0,0 +1,247 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef __WINDOWS__
+#include <cerrno>
+#include <cstdlib>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Thunder {
+
+namespace Service {
+
+    // The RPC::Communicator loads every library it finds in the ProxyStub directory, whether the
+    // service needs it or not. The index is a plain text file naming the libraries that should
+    // be loaded, one per line. The first time (the index does not exist yet) all libraries in the
+    // directory are loaded once, timed, and written to the index with their load time, so it is
+    // easy to spot and strip the ones that are not needed. From then on only the libraries in the
+    // index are exposed to the communicator, through a staging directory of symbolic links. The
+    // communicator hands that directory to every client it announces to, so it has to stay for as
+    // long as the communicator does.
+    class ProxyStubIndex {
+    public:
+        struct Entry {
+            std::string Name;
+            uint64_t LoadTime; // microseconds, 0 if unknown
+        };
+
+        ProxyStubIndex() = delete;
+        ProxyStubIndex(const ProxyStubIndex&) = delete;
+        ProxyStubIndex& operator=(const ProxyStubIndex&) = delete;
+
+        ProxyStubIndex(const string& proxyStubPath, const string& indexFile)
+            : _proxyStubPath(proxyStubPath)
+            , _indexFile(indexFile)
+            , _stagingPath()
+            , _entries()
+            , _available(0)
+            , _created(false)
+        {
+        }
+        ~ProxyStubIndex()
+        {
+            Unstage();
+        }
+
+    public:
+        // Reads the index, or creates it if it does not exist yet. Creating loads every library
+        // once, which is a one-off cost that does not belong in any startup measurement.
+        void Prepare()
+        {
+            Scan();
+
+            if (Load() == false) {
+                Create();
+            }
+        }
+        // Returns the path that should be handed to the communicator.
+        string Stage()
+        {
+            string result(_proxyStubPath);
+
+#ifndef __WINDOWS__
+            RemoveStale();
+
+            string staging(string(_T("/tmp/")) + StagingPrefix() + Core::NumberType<uint32_t>(::getpid()).Text() + _T(".PS"));
+
+            if (::mkdir(staging.c_str(), 0700) == 0) {
+                _stagingPath = staging;
+
+                for (const Entry& entry : _entries) {
+                    string target(Location(entry.Name));
+                    string link(_stagingPath + '/' + entry.Name);
+                    if (::symlink(target.c_str(), link.c_str()) != 0) {
+                        printf("Could not stage ProxyStub library: %s\n", target.c_str());
+                    }
+                }
+
+                result = _stagingPath;
+            }
+            else {
+                printf("Could not create the ProxyStub staging directory %s, loading all of %s\n", staging.c_str(), _proxyStubPath.c_str());
+            }
+#endif
+
+            return (result);
+        }
+        void Unstage()
+        {
+#ifndef __WINDOWS__
+            if (_stagingPath.empty() == false) {
+                for (const Entry& entry : _entries) {
+                    ::unlink((_stagingPath + '/' + entry.Name).c_str());
+                }
+                ::rmdir(_stagingPath.c_str());
+                _stagingPath.clear();
+            }
+#endif
+        }
+        const std::vector<Entry>& Entries() const
+        {
+            return (_entries);
+        }
+        uint32_t Available() const
+        {
+            return (_available);
+        }
+        bool Created() const
+        {
+            return (_created);
+        }
+
+    private:
+#ifndef __WINDOWS__
+        static const TCHAR* StagingPrefix()
+        {
+            return (_T("SimpleService."));
+        }
+        // A service that crashed left its staging directory behind, remove those of the services
+        // that are no longer running. One carrying our own process id is from an earlier process
+        // that had the same id, ours does not exist yet.
+        static void RemoveStale()
+        {
+            Core::Directory staged(_T("/tmp"), (string(StagingPrefix()) + _T("*.PS")).c_str());
+
+            while (staged.Next() == true) {
+                pid_t pid = static_cast<pid_t>(strtoul(staged.Name().c_str() + strlen(StagingPrefix()), nullptr, 10));
+
+                if ((staged.IsDirectory() == true) && (pid != 0) && ((pid == ::getpid()) || ((::kill(pid, 0) != 0) && (errno == ESRCH)))) {
+                    Core::Directory links(staged.Current().c_str(), _T("*"));
+
+                    while (links.Next() == true) {
+                        ::unlink(links.Current().c_str());
+                    }
+                    ::rmdir(staged.Current().c_str());
+                }
+            }
+        }
+#endif
+        string Location(const string& name) const
+        {
+            return (_proxyStubPath + (((_proxyStubPath.empty() == false) && (_proxyStubPath.back() != '/')) ? _T("/") : _T("")) + name);
+        }
+        void Scan()
+        {
+            Core::Directory index(_proxyStubPath.c_str(), _T("*.so"));
+
+            _available = 0;
+            while (index.Next() == true) {
+                _available++;
+            }
+        }
+        bool Load()
+        {
+            std::ifstream file(_indexFile);
+            bool result = file.is_open();
+
+            if (result == true) {
+                string line;
+
+                while (std::getline(file, line)) {
+                    if ((line.empty() == false) && (line[0] != '#')) {
+                        std::istringstream fields(line);
+                        Entry entry { string(), 0 };
+
+                        fields >> entry.Name >> entry.LoadTime;
+
+                        if (entry.Name.empty() == false) {
+                            _entries.push_back(entry);
+                        }
+                    }
+                }
+            }
+
+            return (result);
+        }
+        void Create()
+        {
+            Core::Directory index(_proxyStubPath.c_str(), _T("*.so"));
+
+            while (index.Next() == true) {
+                if (index.IsDirectory() == false) {
+                    Entry entry { index.Name(), 0 };
+                    Core::Time start(Core::Time::Now());
+                    Core::Library library(index.Current().c_str());
+                    entry.LoadTime = Core::Time::Now().Ticks() - start.Ticks();
+
+                    if (library.IsLoaded() == true) {
+                        _entries.push_back(entry);
+                    }
+                    else {
+                        printf("Skipping ProxyStub library %s: %s\n", entry.Name.c_str(), library.Error().c_str());
+                    }
+                }
+            }
+
+            std::ofstream file(_indexFile);
+
+            if (file.is_open() == false) {
+                printf("Could not write the ProxyStub index: %s\n", _indexFile.c_str());
+            }
+            else {
+                file << _T("# ProxyStub libraries to load from ") << _proxyStubPath << _T(", with their load time [us] when indexed.\n");
+                file << _T("# Remove the lines of the libraries this service does not need.\n");
+                for (const Entry& entry : _entries) {
+                    file << entry.Name << ' ' << entry.LoadTime << '\n';
+                }
+                _created = true;
+            }
+        }
+
+    private:
+        const string _proxyStubPath;
+        const string _indexFile;
+        string _stagingPath;
+        std::vector<Entry> _entries;
+        uint32_t _available;
+        bool _created;
+    };
+}
+}
@@ -22,19 +22,151 @@
 #include <core/core.h>
 #include <com/com.h>
 #include "../interface/ISimpleInterface.h"
+#include "../client/Platform.h"
+#include "Metrics.h"
+#include "ProxyStubIndex.h"
+#include <algorithm>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 MODULE_NAME_DECLARATION(BUILD_REFERENCE);
 
 using namespace Thunder;
 
+class Config : public Core::JSON::Container {
+public:
+    Config(const Config&) = delete;
+    Config& operator=(const Config&) = delete;
+
+    Config()
+        : Core::JSON::Container()
+        , Listen(Exchange::SimpleTestAddress)
+        , Path(_T("./PS"))
+        , Stubs()
+        , Threads(1)
+        , Queue(4)
+        , StackSize(0)
+        , Shared(true)
+        , Statistics(0)
+    {
+        Add(_T("listen"), &Listen);
+        Add(_T("path"), &Path);
+        Add(_T("stubs"), &Stubs);
+        Add(_T("threads"), &Threads);
+        Add(_T("queue"), &Queue);
+        Add(_T("stacksize"), &StackSize);
+        Add(_T("shared"), &Shared);
+        Add(_T("statistics"), &Statistics);
+    }
+    ~Config() override = default;
+
+public:
+    Core::JSON::String Listen;
+    Core::JSON::String Path;
+    Core::JSON::String Stubs;
+    Core::JSON::DecUInt8 Threads;
+    Core::JSON::DecUInt32 Queue;
+    Core::JSON::DecUInt32 StackSize;
+    Core::JSON::Boolean Shared;
+    Core::JSON::DecUInt32 Statistics;
+};
+
+// All threads of the pool pull their work from one shared queue, so as long as there is an
+// invoke pending, no thread sits idle. That is all the balancing a stateless IMath needs.
+class WorkerPoolImplementation : public Core::WorkerPool {
+private:
+    class Dispatcher : public Core::ThreadPool::IDispatcher {
+    public:
+        Dispatcher() = delete;
+        Dispatcher(const Dispatcher&) = delete;
+        Dispatcher& operator=(const Dispatcher&) = delete;
+
+        Dispatcher(Service::Metrics& metrics)
+            : _metrics(metrics)
+        {
+        }
+        ~Dispatcher() override = default;
+
+    private:
+        void Initialize() override
+        {
+        }
+        void Deinitialize() override
+        {
+        }
+        void Dispatch(Core::IDispatch* job) override
+        {
+            uint64_t started = _metrics.Dispatching();
+            job->Dispatch();
+            _metrics.Dispatched(started);
+        }
+
+    private:
+        Service::Metrics& _metrics;
+    };
+
+public:
+    WorkerPoolImplementation() = delete;
+    WorkerPoolImplementation(const WorkerPoolImplementation&) = delete;
+    WorkerPoolImplementation& operator=(const WorkerPoolImplementation&) = delete;
+
+    WorkerPoolImplementation(const uint8_t threads, const uint32_t stackSize, const uint32_t queueSize, Service::Metrics& metrics)
+        : Core::WorkerPool(threads, stackSize, queueSize, &_dispatcher, nullptr)
+        , _dispatcher(metrics)
+    {
+        Run();
+    }
+    ~WorkerPoolImplementation() override
+    {
+        Stop();
+    }
+
+private:
+    Dispatcher _dispatcher;
+};
+
+// Only here to see the messages come in, before they are queued for the worker pool.
+class InvokeServer : public RPC::InvokeServer {
+public:
+    InvokeServer() = delete;
+    InvokeServer(const InvokeServer&) = delete;
+    InvokeServer& operator=(const InvokeServer&) = delete;
+
+    InvokeServer(Core::IWorkerPool* workerPool, Service::Metrics& metrics)
+        : RPC::InvokeServer(workerPool)
+        , _metrics(metrics)
+    {
+    }
+    ~InvokeServer() override = default;
+
+public:
+    void Procedure(Core::IPCChannel& source, Core::ProxyType<Core::IIPC>& message) override
+    {
+        _metrics.Arrived();
+        RPC::InvokeServer::Procedure(source, message);
+    }
+
+private:
+    Service::Metrics& _metrics;
+};
+
 class COMServer : public RPC::Communicator {
 private:
-    class Math : public Exchange::IMath {
+    class Math : public Exchange::IMath, public Exchange::IMath2 {
     public:
         Math(const Math&) = delete;
         Math& operator= (const Math&) = delete;
 
-        Math() {
+        Math(Service::Metrics& metrics)
+            : _metrics(metrics) {
         }
         ~Math() override {
         }
@@ -43,18 +175,194 @@ private:
         // Inherited via IMath
         uint32_t Add(const uint16_t A, const uint16_t B, uint16_t& sum) const override
         {
+            Service::Metrics::Scope measure(_metrics, Service::Metrics::MATH_ADD);
             sum = A + B;
             return (Core::ERROR_NONE);
         }
         uint32_t Sub(const uint16_t A, const uint16_t B, uint16_t& sum) const override
         {
+            Service::Metrics::Scope measure(_metrics, Service::Metrics::MATH_SUB);
             sum = A - B;
             return (Core::ERROR_NONE);
         }
+        uint32_t AddBatch(const uint16_t length, const uint16_t A[], const uint16_t B[], uint16_t sum[]) const override
+        {
+            Service::Metrics::Scope measure(_metrics, Service::Metrics::MATH_ADDBATCH);
+            uint16_t index = 0;
+
+#if defined(__SSE2__)
+            for (; (index + 8) <= length; index += 8) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&A[index]));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&B[index]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&sum[index]), _mm_add_epi16(a, b));
+            }
+#elif defined(__ARM_NEON)
+            for (; (index + 8) <= length; index += 8) {
+                vst1q_u16(&sum[index], vaddq_u16(vld1q_u16(&A[index]), vld1q_u16(&B[index])));
+            }
+#endif
+            // Whatever does not fit a full vector register (or all of it, if there is no SIMD support).
+            for (; index < length; index++) {
+                sum[index] = A[index] + B[index];
+            }
+            return (Core::ERROR_NONE);
+        }
+        uint32_t SubBatch(const uint16_t length, const uint16_t A[], const uint16_t B[], uint16_t diff[]) const override
+        {
+            Service::Metrics::Scope measure(_metrics, Service::Metrics::MATH_SUBBATCH);
+            uint16_t index = 0;
+
+#if defined(__SSE2__)
+            for (; (index + 8) <= length; index += 8) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&A[index]));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&B[index]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&diff[index]), _mm_sub_epi16(a, b));
+            }
+#elif defined(__ARM_NEON)
+            for (; (index + 8) <= length; index += 8) {
+                vst1q_u16(&diff[index], vsubq_u16(vld1q_u16(&A[index]), vld1q_u16(&B[index])));
+            }
+#endif
+            for (; index < length; index++) {
+                diff[index] = A[index] - B[index];
+            }
+            return (Core::ERROR_NONE);
+        }
+
+
+        // Inherited via IMath2
+        uint32_t Add64(const int64_t A, const int64_t B, int64_t& sum) const override
+        {
+            Service::Metrics::Scope measure(_metrics, Service::Metrics::MATH2_ADD64);
+            uint32_t result = Core::ERROR_INVALID_RANGE;
+
+            if (((B > 0) && (A > (std::numeric_limits<int64_t>::max() - B))) || ((B < 0) && (A < (std::numeric_limits<int64_t>::min() - B)))) {
+                sum = 0;
+            }
+            else {
+                sum = A + B;
+                result = Core::ERROR_NONE;
+            }
+            return (result);
+        }
+        uint32_t Sub64(const int64_t A, const int64_t B, int64_t& diff) const override
+        {
+            Service::Metrics::Scope measure(_metrics, Service::Metrics::MATH2_SUB64);
+            uint32_t result = Core::ERROR_INVALID_RANGE;
+
+            if (((B < 0) && (A > (std::numeric_limits<int64_t>::max() + B))) || ((B > 0) && (A < (std::numeric_limits<int64_t>::min() + B)))) {
+                diff = 0;
+            }
+            else {
+                diff = A - B;
+                result = Core::ERROR_NONE;
+            }
+            return (result);
+        }
+        uint32_t AddDouble(const double A, const double B, double& sum) const override
+        {
+            Service::Metrics::Scope measure(_metrics, Service::Metrics::MATH2_ADDDOUBLE);
+            sum = A + B;
+            return (Core::ERROR_NONE);
+        }
+        uint32_t SubDouble(const double A, const double B, double& diff) const override
+        {
+            Service::Metrics::Scope measure(_metrics, Service::Metrics::MATH2_SUBDOUBLE);
+            diff = A - B;
+            return (Core::ERROR_NONE);
+        }
+
+        // The reductions below are written as branch free loops over independent lanes, that is
+        // what allows the compiler to turn them into vector instructions.
+        uint32_t Sum(const uint16_t length, const int64_t values[], int64_t& sum) const override
+        {
+            Service::Metrics::Scope measure(_metrics, Service::Metrics::MATH2_SUM);
+
+            // Every value is split in a signed upper and an unsigned lower 32 bit half, summed
+            // separately. With at most 64K values neither of these sums can overflow, so the
+            // overflow check is needed only once, when both halves are combined.
+            int64_t upper = 0;
+            int64_t lower = 0;
+
+            for (uint16_t index = 0; index < length; index++) {
+                upper += (values[index] >> 32);
+                lower += static_cast<int64_t>(static_cast<uint64_t>(values[index]) & 0xFFFFFFFF);
+            }
+
+            upper += (lower >> 32);
+            lower &= 0xFFFFFFFF;
+
+            uint32_t result = Core::ERROR_INVALID_RANGE;
+
+            if ((upper < std::numeric_limits<int32_t>::min()) || (upper > std::numeric_limits<int32_t>::max())) {
+                sum = 0;
+            }
+            else {
+                sum = static_cast<int64_t>((static_cast<uint64_t>(upper) << 32) | static_cast<uint64_t>(lower));
+                result = Core::ERROR_NONE;
+            }
+            return (result);
+        }
+        uint32_t Min(const uint16_t length, const int64_t values[], int64_t& min) const override
+        {
+            Service::Metrics::Scope measure(_metrics, Service::Metrics::MATH2_MIN);
+            uint32_t result = Core::ERROR_BAD_REQUEST;
+
+            if (length > 0) {
+                int64_t lowest = values[0];
+                for (uint16_t index = 1; index < length; index++) {
+                    lowest = (values[index] < lowest ? values[index] : lowest);
+                }
+                min = lowest;
+                result = Core::ERROR_NONE;
+            }
+            return (result);
+        }
+        uint32_t Max(const uint16_t length, const int64_t values[], int64_t& max) const override
+        {
+            Service::Metrics::Scope measure(_metrics, Service::Metrics::MATH2_MAX);
+            uint32_t result = Core::ERROR_BAD_REQUEST;
+
+            if (length > 0) {
+                int64_t highest = values[0];
+                for (uint16_t index = 1; index < length; index++) {
+                    highest = (values[index] > highest ? values[index] : highest);
+                }
+                max = highest;
+                result = Core::ERROR_NONE;
+            }
+            return (result);
+        }
+        uint32_t Dot(const uint16_t length, const double A[], const double B[], double& product) const override
+        {
+            Service::Metrics::Scope measure(_metrics, Service::Metrics::MATH2_DOT);
+
+            // Floating point addition is not associative, so the compiler will not split the sum
+            // over several registers by itself. Four partial sums do it explicitly.
+            double partial[4] = { 0.0, 0.0, 0.0, 0.0 };
+            uint16_t index = 0;
+
+            for (; (index + 4) <= length; index += 4) {
+                partial[0] += A[index + 0] * B[index + 0];
+                partial[1] += A[index + 1] * B[index + 1];
+                partial[2] += A[index + 2] * B[index + 2];
+                partial[3] += A[index + 3] * B[index + 3];
+            }
+            for (; index < length; index++) {
+                partial[0] += A[index] * B[index];
+            }
+
+            product = (partial[0] + partial[1]) + (partial[2] + partial[3]);
+            return (Core::ERROR_NONE);
+        }
 
         BEGIN_INTERFACE_MAP(Math)
             INTERFACE_ENTRY(Exchange::IMath)
+            INTERFACE_ENTRY(Exchange::IMath2)
         END_INTERFACE_MAP
+
+    private:
+        Service::Metrics& _metrics;
     };
 
 public:
@@ -65,11 +373,17 @@ public:
     COMServer(
         const Core::NodeId& source,
         const string& proxyServerPath,
-        const Core::ProxyType< RPC::InvokeServerType<1, 0, 4> >& engine)
+        const Core::ProxyType<Core::IIPCServer>& engine,
+        const bool shared,
+        Service::Metrics& metrics)
         : RPC::Communicator(
             source, 
             proxyServerPath, 
-            Core::ProxyType<Core::IIPCServer>(engine))
+            engine)
+        , _remoteEntry(nullptr)
+        , _metrics(metrics)
+        , _math(shared == true ? Core::ServiceType<Math>::Create<Exchange::IMath>(metrics) : nullptr)
+        , _constructed(Service::Metrics::Now())
     {
         // Once the socket is opened the first exchange between client and server is an 
         // announce message. This announce message hold information the otherside requires
@@ -85,21 +399,50 @@ public:
     ~COMServer() override
     {
         Close(Core::infinite);
+
+        if (_math != nullptr) {
+            _math->Release();
+        }
+    }
+
+public:
+    // Moment the communicator (and with it the ProxyStubs) was set up, right before opening the channel.
+    uint64_t Constructed() const
+    {
+        return (_constructed);
     }
 
 private:
     void* Acquire(const string& className, const uint32_t interfaceId, const uint32_t versionId) override
     {
+        Service::Metrics::Scope measure(_metrics, Service::Metrics::ACQUIRE);
         void* result = nullptr;
-        printf("Acquire:");
 
         // Currently we only support version 1 of the IRPCLink :-)
         if ((versionId == 1) || (versionId == static_cast<uint32_t>(~0))) {
             
             if (interfaceId == ::Exchange::IMath::ID) {
 
-                // Allright, request a new object that implements the requested interface.
-                result = Core::ServiceType<Math>::Create<Exchange::IMath>();
+                if (_math != nullptr) {
+                    // Math holds no state, so all clients can share the same object. Every
+                    // client holds its own reference, we keep ours till the server goes down.
+                    _math->AddRef();
+                    result = _math;
+                }
+                else {
+                    // Allright, request a new object that implements the requested interface.
+                    result = Core::ServiceType<Math>::Create<Exchange::IMath>(_metrics);
+                }
+            }
+            else if (interfaceId == ::Exchange::IMath2::ID) {
+
+                if (_math != nullptr) {
+                    // Same shared object, QueryInterface takes the reference for the client.
+                    result = _math->QueryInterface(Exchange::IMath2::ID);
+                }
+                else {
+                    result = Core::ServiceType<Math>::Create<Exchange::IMath2>(_metrics);
+                }
             }
         }
         return (result);
@@ -112,22 +455,75 @@ private:
     }
 private:
     Exchange::IMath* _remoteEntry;
+    Service::Metrics& _metrics;
+    Exchange::IMath* _math;
+    const uint64_t _constructed;
 };
 
-bool ParseOptions(int argc, char** argv, Core::NodeId& comChannel, string& psPath)
+bool ParseOptions(int argc, char** argv, Config& config)
 {
     int index = 1;
     bool showHelp = false;
-    comChannel = Core::NodeId(Exchange::SimpleTestAddress);
-    psPath = _T("./PS");
 
     while ((index < argc) && (!showHelp)) {
         if (strcmp(argv[index], "-listen") == 0) {
-            comChannel = Core::NodeId(argv[index + 1]);
+            config.Listen = argv[index + 1];
             index++;
         }
         else if (strcmp(argv[index], "-path") == 0) {
-            psPath = argv[index + 1];
+            config.Path = argv[index + 1];
+            index++;
+        }
+        else if ((strcmp(argv[index], "-stubs") == 0) && ((index + 1) < argc)) {
+            config.Stubs = argv[index + 1];
+            index++;
+        }
+        else if ((strcmp(argv[index], "-threads") == 0) && ((index + 1) < argc)) {
+            config.Threads = static_cast<uint8_t>(std::min(std::max(atoi(argv[index + 1]), 1), 255));
+            index++;
+        }
+        else if ((strcmp(argv[index], "-queue") == 0) && ((index + 1) < argc)) {
+            config.Queue = static_cast<uint32_t>(std::max(atoi(argv[index + 1]), 1));
+            index++;
+        }
+        else if ((strcmp(argv[index], "-stack") == 0) && ((index + 1) < argc)) {
+            config.StackSize = static_cast<uint32_t>(atoi(argv[index + 1]));
+            index++;
+        }
+        else if ((strcmp(argv[index], "-instance") == 0) && ((index + 1) < argc)) {
+            if (strcmp(argv[index + 1], "shared") == 0) {
+                config.Shared = true;
+            }
+            else if (strcmp(argv[index + 1], "private") == 0) {
+                config.Shared = false;
+            }
+            else {
+                showHelp = true;
+            }
+            index++;
+        }
+        else if ((strcmp(argv[index], "-stats") == 0) && ((index + 1) < argc)) {
+            config.Statistics = static_cast<uint32_t>(atoi(argv[index + 1]));
+            index++;
+        }
+        else if ((strcmp(argv[index], "-config") == 0) && ((index + 1) < argc)) {
+            // Settings from the file override what was passed before it, options after it override the file.
+            Core::File file(string(argv[index + 1]));
+            Core::OptionalType<Core::JSON::Error> error;
+
+            if (file.Open(true) == false) {
+                printf("Could not open config file: %s\n", argv[index + 1]);
+                showHelp = true;
+            }
+            else if (config.IElement::FromFile(file, error) == false) {
+                printf("Parsing config file %s failed: %s\n", argv[index + 1], (error.IsSet() ? Core::JSON::ErrorDisplayMessage(error.Value()).c_str() : "unknown"));
+                showHelp = true;
+            }
+            else {
+                // Same limits as the options: without a thread or a queue slot nothing is ever dispatched.
+                config.Threads = std::max<uint8_t>(config.Threads.Value(), 1);
+                config.Queue = std::max<uint32_t>(config.Queue.Value(), 1);
+            }
             index++;
         }
         else if (strcmp(argv[index], "-h") == 0) {
@@ -144,34 +540,106 @@ int main(int argc, char* argv[])
 {
     // The core::NodeId can hold an IPv4, IPv6, domain, HCI, L2CAP or netlink address
     // Here we create a domain socket address
-    Core::NodeId comChannel;
-    string psPath;
+    Config config;
 
     printf("\nSimple COMRPC Service offering IMath interface\n");
 
-    if (ParseOptions(argc, argv, comChannel, psPath) == true) {
+    if (ParseOptions(argc, argv, config) == true) {
         printf("Options:\n");
-        printf("-listen <IP/FQDN>:<port> [default: %s]\n", Exchange::SimpleTestAddress);
+        printf("-listen <IP/FQDN>:<port> | local:<name> [default: %s]\n", Exchange::SimpleTestAddress);
         printf("-path <Path to the location of the ProxyStubs> [default: ./PS]\n");
+        printf("-stubs <index file> [only load the ProxyStubs listed in this file, created from -path if it does not exist]\n");
+        printf("-threads <count> [threads handling incoming invokes, default: 1]\n");
+        printf("-queue <depth> [invokes that can be pending before the receiving side blocks, default: 4]\n");
+        printf("-stack <size> [stack size of the invoke threads, default: 0 (system default)]\n");
+        printf("-instance <shared|private> [one IMath object for all clients or one per Acquire, default: shared]\n");
+        printf("-stats <seconds> [periodically dump the call statistics, default: 0 (only on <S>)]\n");
+        printf("-config <file> [JSON file with any of: listen, path, stubs, threads, queue, stacksize, shared, statistics]\n");
         printf("-h This text\n\n");
     }
     else
     {
         int element;
-        COMServer server(comChannel, psPath, Core::ProxyType< RPC::InvokeServerType<1, 0, 4> >::Create());
+        Core::NodeId comChannel(Platform::Channel(config.Listen.Value().c_str()));
+        string psPath(config.Path.Value());
+        Service::ProxyStubIndex stubIndex(psPath, config.Stubs.Value());
+        // The queue plus the one job the receiving side may be blocked on to hand it over.
+        Service::Metrics metrics(static_cast<uint64_t>(config.Queue.Value()) + 1);
+        uint64_t preparing = Service::Metrics::Now();
+
+        if (config.Stubs.Value().empty() == false) {
+            stubIndex.Prepare();
+        }
+
+        uint64_t prepared = Service::Metrics::Now() - preparing;
+
+        uint64_t start = Service::Metrics::Now();
+        string stubPath(config.Stubs.Value().empty() == true ? psPath : stubIndex.Stage());
+        uint64_t staged = Service::Metrics::Now();
+        WorkerPoolImplementation workerPool(config.Threads.Value(), config.StackSize.Value(), config.Queue.Value(), metrics);
+        uint64_t engineReady = Service::Metrics::Now();
+        COMServer server(comChannel, stubPath, Core::ProxyType<Core::IIPCServer>(Core::ProxyType<InvokeServer>::Create(&workerPool, metrics)), config.Shared.Value(), metrics);
+        uint64_t opened = Service::Metrics::Now();
+
         printf("Channel:        %s:[%d]\n", comChannel.HostAddress().c_str(), comChannel.PortNumber());
-        printf("ProxyStub path: %s\n\n", psPath.c_str());
+        printf("ProxyStub path: %s\n", psPath.c_str());
+        if (config.Stubs.Value().empty() == false) {
+            printf("ProxyStubs:     %u of %u libraries from %s", static_cast<uint32_t>(stubIndex.Entries().size()), stubIndex.Available(), config.Stubs.Value().c_str());
+            if (stubIndex.Created() == true) {
+                printf(" (just created in %.3f ms, not part of the startup below)", prepared / 1000000.0);
+            }
+            printf("\n");
+        }
+        printf("Startup:        %.3f ms staging, %.3f ms engine, %.3f ms communicator/ProxyStubs, %.3f ms open, %.3f ms total\n",
+            (staged - start) / 1000000.0,
+            (engineReady - staged) / 1000000.0,
+            (server.Constructed() - engineReady) / 1000000.0,
+            (opened - server.Constructed()) / 1000000.0,
+            (opened - start) / 1000000.0);
+        printf("Invoke engine:  %d thread(s), %u queue slots\n", config.Threads.Value(), config.Queue.Value());
+        printf("IMath instance: %s\n\n", (config.Shared.Value() == true ? "shared" : "private"));
+
+        std::mutex stopLock;
+        std::condition_variable stopSignal;
+        bool stopped = false;
+        std::thread reporter;
+
+        if (config.Statistics.Value() != 0) {
+            reporter = std::thread([&]() {
+                std::unique_lock<std::mutex> guard(stopLock);
+                while (stopSignal.wait_for(guard, std::chrono::seconds(config.Statistics.Value()), [&]() { return (stopped); }) == false) {
+                    metrics.Dump(stdout);
+                }
+            });
+        }
 
         do {
             printf("\n>");
             element = toupper(getchar());
 
             switch (element) {
+            case 'S': metrics.Dump(stdout); break;
             case 'Q': break;
+            case '?':
+                printf("Options available:\n");
+                printf("=======================================================================\n");
+                printf("<S> Show the call statistics.\n");
+                printf("<Q> Stop the service.\n");
+                printf("<?> Have no clue what I can do, tell me.\n");
+                break;
             default: break;
             }
 
         } while (element != 'Q');
+
+        if (reporter.joinable() == true) {
+            {
+                std::unique_lock<std::mutex> guard(stopLock);
+                stopped = true;
+            }
+            stopSignal.notify_one();
+            reporter.join();
+        }
     }
 
     Core::Singleton::Dispose();
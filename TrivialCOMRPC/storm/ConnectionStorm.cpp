@@ -0,0 +1,254 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_NAME ConnectionStorm
+
+#include <core/core.h>
+#include <com/com.h>
+#include "../interface/ISimpleInterface.h"
+#include "../client/Platform.h"
+#include "../client/Statistics.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+MODULE_NAME_DECLARATION(BUILD_REFERENCE)
+
+using namespace Thunder;
+
+// Every client runs the same cycle as the <M>, <A>, <D> and <Q> keys of the SimpleClient, over
+// and over again: open a channel, acquire the IMath, do one call, release it and close the
+// channel. Each client owns its own RPC::CommunicatorClient, so each cycle is a fresh
+// connection, announce and acquire on the server side.
+
+struct Options {
+    Options()
+        : Address(Exchange::SimpleTestAddress)
+        , Clients(16)
+        , Cycles(100)
+        , ServerPid(0)
+        , Format(Benchmark::Format::TEXT)
+        , Output()
+        , Label(_T("ConnectionStorm"))
+    {
+    }
+
+    Core::NodeId Address;
+    uint32_t Clients;
+    uint32_t Cycles;
+    uint32_t ServerPid;
+    Benchmark::Format Format;
+    string Output;
+    string Label;
+};
+
+enum phase {
+    OPEN,
+    ACQUIRE,
+    CALL,
+    CLOSE,
+    PHASES
+};
+
+static const TCHAR* PhaseNames[PHASES] = { _T("open"), _T("acquire"), _T("call"), _T("close") };
+
+bool ParseOptions(int argc, char** argv, Options& options)
+{
+    int index = 1;
+    bool showHelp = false;
+
+    while ((index < argc) && (!showHelp)) {
+        if ((strcmp(argv[index], "-connect") == 0) && ((index + 1) < argc)) {
+            options.Address = Platform::Channel(argv[index + 1]);
+            index++;
+        }
+        else if ((strcmp(argv[index], "-clients") == 0) && ((index + 1) < argc)) {
+            options.Clients = std::max(atoi(argv[index + 1]), 1);
+            index++;
+        }
+        else if ((strcmp(argv[index], "-cycles") == 0) && ((index + 1) < argc)) {
+            options.Cycles = std::max(atoi(argv[index + 1]), 1);
+            index++;
+        }
+        else if ((strcmp(argv[index], "-pid") == 0) && ((index + 1) < argc)) {
+            options.ServerPid = atoi(argv[index + 1]);
+            index++;
+        }
+        else if ((strcmp(argv[index], "-format") == 0) && ((index + 1) < argc)) {
+            showHelp = (Benchmark::ParseFormat(argv[index + 1], options.Format) == false);
+            index++;
+        }
+        else if ((strcmp(argv[index], "-output") == 0) && ((index + 1) < argc)) {
+            options.Output = argv[index + 1];
+            index++;
+        }
+        else if ((strcmp(argv[index], "-label") == 0) && ((index + 1) < argc)) {
+            options.Label = argv[index + 1];
+            index++;
+        }
+        else {
+            showHelp = true;
+        }
+        index++;
+    }
+
+    return (showHelp);
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    int exitCode = 0;
+
+    printf("\nConnectionStorm opens, uses and closes IMath connections to the SimpleService\n");
+
+    if (ParseOptions(argc, argv, options) == true) {
+        printf("Options:\n");
+        printf("-connect <IP/FQDN>:<port> | local:<name> [default: %s]\n", Exchange::SimpleTestAddress);
+        printf("-clients <count> [concurrent clients, default: 16]\n");
+        printf("-cycles <count> [open/acquire/call/release/close cycles per client, default: 100]\n");
+        printf("-pid <pid> [process id of the SimpleService, to track its memory usage]\n");
+        printf("-format <text|csv|json> [report format, default: text]\n");
+        printf("-output <file> [append the report to this file, CSV tables other than the report go next to it as <file>.<table>, default: console]\n");
+        printf("-label <name> [tag for the report, e.g. the Thunder version under test]\n");
+        printf("-h This text\n\n");
+    }
+    else {
+        std::vector<std::vector<Benchmark::Latencies>> samples(options.Clients, std::vector<Benchmark::Latencies>(PHASES));
+        std::vector<std::vector<uint64_t>> failures(options.Clients, std::vector<uint64_t>(PHASES, 0));
+        std::vector<std::thread> clients;
+        std::atomic<bool> start(false);
+        std::atomic<uint32_t> running(options.Clients);
+
+        uint32_t rssBefore = (options.ServerPid != 0 ? Platform::ResidentSize(options.ServerPid) : 0);
+        uint32_t rssPeak = rssBefore;
+
+        for (uint32_t index = 0; index < options.Clients; index++) {
+            clients.emplace_back([&, index]() {
+                std::vector<Benchmark::Latencies>& latencies(samples[index]);
+
+                while (start.load() == false) {
+                    std::this_thread::yield();
+                }
+
+                for (uint32_t cycle = 0; cycle < options.Cycles; cycle++) {
+                    Core::ProxyType<RPC::CommunicatorClient> client(Core::ProxyType<RPC::CommunicatorClient>::Create(options.Address));
+
+                    uint64_t stamp = Benchmark::Now();
+                    client->Open(2000);
+                    uint64_t opened = Benchmark::Now();
+                    latencies[OPEN].Add(opened - stamp);
+
+                    if (client->IsOpen() == false) {
+                        failures[index][OPEN]++;
+                        continue;
+                    }
+
+                    Exchange::IMath* math = client->Acquire<Exchange::IMath>(8000, _T("Math"), ~0);
+                    uint64_t acquired = Benchmark::Now();
+                    latencies[ACQUIRE].Add(acquired - opened);
+
+                    if (math == nullptr) {
+                        failures[index][ACQUIRE]++;
+                    }
+                    else {
+                        uint16_t sum = 0;
+                        if ((math->Add(static_cast<uint16_t>(cycle), 1, sum) != Core::ERROR_NONE) || (sum != static_cast<uint16_t>(cycle + 1))) {
+                            failures[index][CALL]++;
+                        }
+                        latencies[CALL].Add(Benchmark::Now() - acquired);
+
+                        math->Release();
+                    }
+
+                    stamp = Benchmark::Now();
+                    if (client->Close(Core::infinite) != Core::ERROR_NONE) {
+                        failures[index][CLOSE]++;
+                    }
+                    latencies[CLOSE].Add(Benchmark::Now() - stamp);
+                }
+
+                running--;
+            });
+        }
+
+        uint64_t begin = Benchmark::Now();
+        start = true;
+
+        // Sample the server while the storm is raging, the peak is what tells about setup costs,
+        // what remains afterwards is what tells about leaks.
+        while (running.load() != 0) {
+            if (options.ServerPid != 0) {
+                rssPeak = std::max(rssPeak, Platform::ResidentSize(options.ServerPid));
+            }
+            SleepMs(100);
+        }
+
+        for (std::thread& client : clients) {
+            client.join();
+        }
+
+        uint64_t duration = Benchmark::Now() - begin;
+
+        // Give the server the chance to clean up what is closed before the final measurement.
+        SleepMs(1000);
+        uint32_t rssAfter = (options.ServerPid != 0 ? Platform::ResidentSize(options.ServerPid) : 0);
+
+        Benchmark::Output sink(options.Output);
+        FILE* output = sink.File();
+
+        uint64_t totalFailures = 0;
+
+        for (uint8_t phase = 0; phase < PHASES; phase++) {
+            Benchmark::Result report;
+            report.Label = options.Label + '/' + PhaseNames[phase];
+            report.Threads = options.Clients;
+            report.Duration = duration;
+
+            for (uint32_t index = 0; index < options.Clients; index++) {
+                report.Samples.Merge(samples[index][phase]);
+                report.Failures += failures[index][phase];
+            }
+            totalFailures += report.Failures;
+            report.Calls = report.Samples.Count();
+
+            Benchmark::Report(sink, options.Format, report);
+        }
+
+        if (options.ServerPid != 0) {
+            switch (options.Format) {
+            case Benchmark::Format::CSV:
+                fprintf(sink.Table(_T("memory"), "label,pid,rss_before_kb,rss_peak_kb,rss_after_kb"), "%s/memory,%u,%u,%u,%u\n", options.Label.c_str(), options.ServerPid, rssBefore, rssPeak, rssAfter);
+                break;
+            case Benchmark::Format::JSON:
+                fprintf(output, "{\"label\":\"%s/memory\",\"pid\":%u,\"rss_before_kb\":%u,\"rss_peak_kb\":%u,\"rss_after_kb\":%u}\n", options.Label.c_str(), options.ServerPid, rssBefore, rssPeak, rssAfter);
+                break;
+            default:
+                fprintf(output, "Server RSS:   %u KB before, %u KB peak, %u KB after (%+d KB)\n", rssBefore, rssPeak, rssAfter, static_cast<int32_t>(rssAfter) - static_cast<int32_t>(rssBefore));
+                break;
+            }
+        }
+
+        exitCode = (totalFailures == 0 ? 0 : 1);
+    }
+
+    Core::Singleton::Dispose();
+
+    return (exitCode);
+}
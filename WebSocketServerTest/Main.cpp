@@ -21,6 +21,8 @@
 #include <websocket/websocket.h>
 #include <condition_variable>
 #include <mutex>
+#include <string.h>
+#include <thread>
 
 MODULE_NAME_DECLARATION(BUILD_REFERENCE)
 
@@ -162,6 +164,184 @@ namespace Tests {
     template<typename INTERFACE>
     bool JsonSocketServer<INTERFACE>::_done = false;
 
+    class Registration : public Core::JSON::Container {
+    public:
+        Registration(const Registration&) = delete;
+        Registration& operator=(const Registration&) = delete;
+
+        Registration()
+            : Core::JSON::Container()
+            , Event()
+            , Callsign()
+        {
+            Add(_T("event"), &Event);
+            Add(_T("id"), &Callsign);
+        }
+        ~Registration()
+        {
+        }
+
+    public:
+        Core::JSON::String Event;
+        Core::JSON::String Callsign;
+    };
+
+    class RPCFactory : public Core::ProxyPoolType<Core::JSONRPC::Message> {
+    public:
+        RPCFactory() = delete;
+        RPCFactory(const RPCFactory&) = delete;
+        RPCFactory& operator=(const RPCFactory&) = delete;
+
+        RPCFactory(const uint32_t number)
+            : Core::ProxyPoolType<Core::JSONRPC::Message>(number)
+        {
+        }
+        virtual ~RPCFactory()
+        {
+        }
+
+    public:
+        Core::ProxyType<Core::JSON::IElement> Element(const string&)
+        {
+            return (Core::ProxyType<Core::JSON::IElement>(Core::ProxyPoolType<Core::JSONRPC::Message>::Element()));
+        }
+    };
+
+    // Stand-in for an event of the JSONRPCPlugin, for the -events run of the SimpleJSONRPCClient.
+    // It answers "register" and "unregister" the way the Thunder JSON-RPC gateway does and, while
+    // a client is registered, sends it the event at <rate> per second, each with a sequence number
+    // and the moment (microseconds since the epoch) it was sent.
+    class EventSocketServer : public Core::StreamJSONType<Web::WebSocketServerType<Core::SocketStream>, RPCFactory&, Core::JSON::IElement> {
+    private:
+        typedef Core::StreamJSONType<Web::WebSocketServerType<Core::SocketStream>, RPCFactory&, Core::JSON::IElement> BaseClass;
+
+    public:
+        EventSocketServer() = delete;
+        EventSocketServer(const EventSocketServer&) = delete;
+        EventSocketServer& operator=(const EventSocketServer&) = delete;
+
+        EventSocketServer(const SOCKET& socket, const Core::NodeId& remoteNode, Core::SocketServerType<EventSocketServer>*)
+            : BaseClass(2, _objectFactory, false, false, false, socket, remoteNode, 512, 512)
+            , _objectFactory(4)
+            , _lock()
+            , _signal()
+            , _designator()
+            , _start(0)
+            , _sequence(0)
+            , _stopped(false)
+            , _emitter(&EventSocketServer::Emitter, this)
+        {
+        }
+        virtual ~EventSocketServer()
+        {
+            {
+                std::unique_lock<std::mutex> guard(_lock);
+                _stopped = true;
+                _signal.notify_one();
+            }
+            _emitter.join();
+        }
+
+    public:
+        virtual bool IsIdle() const
+        {
+            return (true);
+        }
+        virtual void StateChange()
+        {
+            if (this->IsOpen() == false) {
+                Registered(string());
+            }
+        }
+        virtual void Received(Core::ProxyType<Core::JSON::IElement>& jsonObject)
+        {
+            Core::ProxyType<Core::JSONRPC::Message> request(jsonObject);
+
+            if (request.IsValid() == true) {
+                Core::ProxyType<Core::JSONRPC::Message> response(Core::ProxyType<Core::JSONRPC::Message>::Create());
+                string designator(request->Designator.Value());
+                string method(designator.substr(designator.find_last_of('.') + 1));
+
+                response->JSONRPC = _T("2.0");
+                response->Id = request->Id.Value();
+
+                if (method == _T("register")) {
+                    Registration registration;
+                    registration.FromString(request->Parameters.Value());
+                    Registered(registration.Callsign.Value() + '.' + registration.Event.Value());
+                    response->Result = _T("0");
+                } else if (method == _T("unregister")) {
+                    Registered(string());
+                    response->Result = _T("0");
+                } else {
+                    response->Error.Code = -32601;
+                    response->Error.Text = _T("Unknown method");
+                }
+
+                Core::ProxyType<Core::JSON::IElement> element(response);
+                this->Submit(element);
+            }
+        }
+        virtual void Send(Core::ProxyType<Core::JSON::IElement>& jsonObject)
+        {
+        }
+
+    private:
+        void Registered(const string& designator)
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+
+            _designator = designator;
+            _start = Core::Time::Now().Ticks();
+            _sequence = 0;
+            _signal.notify_one();
+        }
+        // Wakes up every millisecond and sends all events that are due by then, so the rate holds
+        // even if it wakes up late.
+        void Emitter()
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+
+            while (_stopped == false) {
+                if (_designator.empty() == true) {
+                    _signal.wait(guard);
+                    continue;
+                }
+
+                uint64_t due = ((Core::Time::Now().Ticks() - _start) * _rate) / 1000000;
+
+                while (_sequence < due) {
+                    Core::ProxyType<Core::JSONRPC::Message> event(Core::ProxyType<Core::JSONRPC::Message>::Create());
+
+                    _sequence++;
+                    event->JSONRPC = _T("2.0");
+                    event->Designator = _designator;
+                    event->Parameters = _T("{\"seq\":") + Core::NumberType<uint64_t>(_sequence).Text() + _T(",\"timestamp\":") + Core::NumberType<uint64_t>(Core::Time::Now().Ticks()).Text() + _T("}");
+
+                    Core::ProxyType<Core::JSON::IElement> element(event);
+                    this->Submit(element);
+                }
+
+                _signal.wait_for(guard, std::chrono::milliseconds(1));
+            }
+        }
+
+    private:
+        RPCFactory _objectFactory;
+        std::mutex _lock;
+        std::condition_variable _signal;
+        string _designator;
+        uint64_t _start;
+        uint64_t _sequence;
+        bool _stopped;
+        std::thread _emitter;
+
+    public:
+        static uint32_t _rate;
+    };
+
+    uint32_t EventSocketServer::_rate = 1000;
+
 } // Tests
 } // WPEFramework
 
@@ -175,7 +355,28 @@ int main (int argc, char* argv[])
      Config config;
      Core::NodeId source(config.Connector.Value().c_str());
 
-     {
+     if ((argc > 2) && (strcmp(argv[1], "-emit") == 0)) {
+         EventSocketServer::_rate = std::max(atoi(argv[2]), 1);
+
+         Core::SocketServerType<EventSocketServer> eventServer(Core::NodeId(source, source.PortNumber()));
+         eventServer.Open(Core::infinite);
+
+         printf("jsonWebSocketServer sending %u events/s to whoever registers, Q to quit\n", EventSocketServer::_rate);
+
+         int element;
+
+         do {
+             printf("\n>");
+             element = toupper(getchar());
+         } while (element != 'Q');
+
+         eventServer.Close(1000);
+     }
+     else if (argc > 1) {
+         printf("Options:\n");
+         printf("-emit <events/s> [stand-in for JSONRPCPlugin events, for SimpleJSONRPCClient -events]\n");
+     }
+     else {
 	     Core::SocketServerType<JsonSocketServer<Core::JSON::IElement>> jsonWebSocketServer(Core::NodeId(source, source.PortNumber()));
 	     jsonWebSocketServer.Open(Core::infinite);
 	 